@@ -0,0 +1,162 @@
+/* dmatest --- check the DMA screen updates against a simulated SPI1 and OLED */
+
+// Built for the host by 'make check', with the firmware included whole.
+// Each update's bytes must be exactly the window commands followed by
+// the pixels, and drawing straight after starting an update must not
+// change what that update sends.
+
+#define main spi_oled_main
+#include "spi_oled.c"
+#undef main
+
+#include "oledsim.h"
+
+
+/* rgb --- return the RGB565 colour the OLED should get for a frame buffer pixel */
+
+static uint16_t rgb(const pixel_t p)
+{
+#ifdef INDEXED_FRAME
+   return (Palette[p]);
+#else
+   return (p);
+#endif
+}
+
+
+/* pattern --- fill a window of the frame buffer with pixels that differ from their neighbours */
+
+static void pattern(const int seed, const int x1, const int y1, const int x2, const int y2)
+{
+   int x, y;
+
+   markDirty(x1, y1, x2, y2);
+
+   for (y = y1; y <= y2; y++)
+      for (x = x1; x <= x2; x++)
+         Frame[y][x] = (x * 7) + (y * 131) + (seed * 17);
+}
+
+
+/* sameAsFrame --- return true if OLED RAM holds the frame buffer within a window */
+
+static bool sameAsFrame(const int x1, const int y1, const int x2, const int y2)
+{
+   int x, y;
+
+   for (y = y1; y <= y2; y++)
+      for (x = x1; x <= x2; x++)
+         if (Oled.ram[y][x] != rgb(Frame[y][x]))
+            return (false);
+
+   return (true);
+}
+
+
+/* checkStream --- send one window and check every byte that goes to the OLED */
+
+static void checkStream(const int x1, const int y1, const int x2, const int y2)
+{
+   const uint16_t head[] = {
+      SSD1351_SETCOLUMN, x1 | SIM_DC, x2 | SIM_DC,
+      SSD1351_SETROW, y1 | SIM_DC, y2 | SIM_DC,
+      SSD1351_WRITERAM
+   };
+   const uint32_t n = sizeof (head) / sizeof (head[0]);
+   uint32_t i;
+   int x, y;
+   bool ok = true;
+
+   pattern(x1 + y2, x1, y1, x2, y2);
+
+   simTraceReset();
+
+   updDirty();
+   updscreenWait();
+
+   CHECK(SimTraceLen == (n + (((x2 - x1) + 1) * ((y2 - y1) + 1) * 2)));
+
+   for (i = 0; (i < n) && (i < SimTraceLen); i++)
+      ok &= (SimTrace[i] == head[i]);
+
+   for (y = y1; y <= y2; y++) {
+      for (x = x1; (x <= x2) && ((i + 1) < SimTraceLen); x++) {
+         const uint16_t c = rgb(Frame[y][x]);
+
+         ok &= (SimTrace[i++] == ((c >> 8) | SIM_DC));
+         ok &= (SimTrace[i++] == ((c & 0xFF) | SIM_DC));
+      }
+   }
+
+   CHECK(ok);
+   CHECK(sameAsFrame(x1, y1, x2, y2));
+
+   // CS is up again and SPI1 is back in 8-bit mode for commands
+   CHECK((GPIOA->ODR & GPIO_BSRR_BS4) != 0);
+   CHECK((SPI1->CR1 & SPI_CR1_DFF) == 0);
+}
+
+
+/* checkNoTearing --- draw over a window while it's still being sent */
+
+static void checkNoTearing(const int x1, const int y1, const int x2, const int y2)
+{
+   pattern(2, x1, y1, x2, y2);
+   updDirty();
+
+   // This has to wait for the rows that haven't gone yet
+   fillRect(x1, y1, x2, y2, SSD1351_RED, SSD1351_BLUE);
+   updscreenWait();
+
+   pattern(2, x1, y1, x2, y2);
+   CHECK(sameAsFrame(x1, y1, x2, y2));
+
+   // And then it goes with the next update
+   fillRect(x1, y1, x2, y2, SSD1351_RED, SSD1351_BLUE);
+   updDirty();
+   updscreenWait();
+
+   CHECK(sameAsFrame(x1, y1, x2, y2));
+}
+
+
+int main(void)
+{
+   simBegin();
+
+   initSPI();
+   initDMA();
+
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+
+   OLED_begin(MAXX, MAXY);
+
+   // Drawing code gets control back while the pixels are still going
+   pattern(0, 0, 0, MAXX - 1, MAXY - 1);
+   updDirty();
+   CHECK(updscreenBusy());
+   updscreenWait();
+   CHECK(sameAsFrame(0, 0, MAXX - 1, MAXY - 1));
+
+   checkStream(0, 0, MAXX - 1, MAXY - 1);     // One transfer for the lot
+   checkStream(0, 40, MAXX - 1, 41);
+   checkStream(5, 3, 70, 9);                  // A transfer for each row
+   checkStream(127, 0, 127, 127);
+   checkStream(64, 100, 64, 100);
+
+   checkNoTearing(0, 0, MAXX - 1, MAXY - 1);
+   checkNoTearing(10, 20, 100, 120);
+   checkNoTearing(0, 127, MAXX - 1, 127);
+
+   // Commands queued behind the pixels must wait for them
+   pattern(4, 0, 0, MAXX - 1, MAXY - 1);
+   updDirty();
+   cmdQueue1b(SSD1351_STARTLINE, 0);
+   cmdFlush(0);
+   CHECK(!updscreenBusy());
+   CHECK(sameAsFrame(0, 0, MAXX - 1, MAXY - 1));
+
+   return (simReport("dmatest"));
+}
@@ -0,0 +1,90 @@
+/* fillbench --- time the '!' fill benchmark's primitives on the host */
+
+// Built for the host by 'make bench', with the firmware included whole.
+// The same fills as benchFill() are timed, but with the host's clock,
+// since the simulated DWT cycle counter only counts host time and its
+// "cycles" would mean nothing. The results are host nanoseconds per
+// pixel; it's the ratios between the primitives and the pixel loop that
+// are worth comparing. Cycle counts come from '!' on the target.
+
+#define main spi_oled_main
+#include "spi_oled.c"
+#undef main
+
+#include "oledsim.h"
+
+#define NRUNS  (3)
+
+
+/* fill --- fill the frame buffer BENCH_LOOPS times with one of the primitives, returning the pixels written */
+
+static uint32_t fill(const int kind)
+{
+   const pixel_t p = colourIndex(SSD1351_BLUE);
+   volatile pixel_t (*const frame)[MAXX] = Frame;
+   int i, x, y;
+
+   for (i = 0; i < BENCH_LOOPS; i++) {
+      switch (kind) {
+      case 0:     // The way setHline() used to work, through a volatile pointer so it stays a loop
+         for (y = 0; y < MAXY; y++)
+            for (x = 0; x < MAXX; x++)
+               frame[y][x] = p;
+         break;
+      case 1:
+         for (y = 0; y < MAXY; y++)
+            setHline(0, MAXX - 1, y, SSD1351_GREEN);
+         break;
+      case 2:     // Odd start and end, so both ragged edges are exercised
+         for (y = 0; y < MAXY; y++)
+            setHline(1, MAXX - 2, y, SSD1351_RED);
+         break;
+      case 3:
+         fillRect(0, 0, MAXX - 1, MAXY - 1, SSD1351_WHITE, SSD1351_BLUE);
+         break;
+      case 4:
+         greyFrame();
+         break;
+      }
+   }
+
+   if (kind == 2)
+      return (BENCH_LOOPS * (MAXX - 2) * MAXY);
+   else
+      return (BENCH_LOOPS * MAXX * MAXY);
+}
+
+
+int main(void)
+{
+   static const char *const names[] = {"Pixel loop", "setHline", "setHline ragged", "fillRect", "greyFrame"};
+   int i, kind;
+   uint32_t pixels;
+   double t;
+
+   simBegin();
+
+   initSPI();
+   initDMA();
+
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+
+   OLED_begin(MAXX, MAXY);
+   updscreenWait();
+
+   for (i = 0; i < NRUNS; i++) {
+      printf("Run %d\n", i + 1);
+
+      for (kind = 0; kind < 5; kind++) {
+         t = simSeconds();
+         pixels = fill(kind);
+         t = simSeconds() - t;
+
+         printf("%-16s %ld pixels in %.0f us = %.3f host ns/pixel\n", names[kind], (long)pixels, t * 1e6, (t * 1e9) / pixels);
+      }
+   }
+
+   return (simReport("fillbench"));
+}
@@ -0,0 +1,236 @@
+/* scrolltest --- check the strip chart's hardware scrolling on a simulated OLED */
+
+// Built for the host by 'make check', with the firmware included whole.
+// The strip chart runs for more than a screenful of lines, so the rows
+// of the frame buffer wrap. Each line must cost one row of pixels, and
+// the simulated OLED, with its start line, must show the frame buffer
+// as scrollRow() maps it. The start line must follow the new row's
+// pixels, so that the stale row is never shown. Then a marquee band is set scrolling sideways
+// and the screen updated around it; the simulation counts an error if
+// the band's rows of OLED RAM are written while it's moving. Updates
+// that miss the band must leave it running, and not wait for the DMA.
+
+#define main spi_oled_main
+#include "spi_oled.c"
+#undef main
+
+#include "oledsim.h"
+
+#define NLINES  (300)
+
+
+/* rgb --- return the RGB565 colour the OLED should get for a frame buffer pixel */
+
+static uint16_t rgb(const pixel_t p)
+{
+#ifdef INDEXED_FRAME
+   return (Palette[p]);
+#else
+   return (p);
+#endif
+}
+
+
+/* screenIsFrame --- return true if the OLED shows the frame buffer, scrolled */
+
+static bool screenIsFrame(void)
+{
+   int x, y;
+
+   for (y = 0; y < MAXY; y++)
+      for (x = 0; x < MAXX; x++)
+         if (simScreen(x, y) != rgb(Frame[scrollRow(y)][x]))
+            return (false);
+
+   return (true);
+}
+
+
+/* startLineLast --- return true if the start line was sent, after every pixel */
+
+static bool startLineLast(void)
+{
+   uint32_t i;
+   int32_t startLine = -1, writeRam = -1;
+
+   for (i = 0; i < SimTraceLen; i++) {
+      if (SimTrace[i] == SSD1351_STARTLINE)
+         startLine = i;
+      else if (SimTrace[i] == SSD1351_WRITERAM)
+         writeRam = i;
+   }
+
+   return ((startLine >= 0) && (writeRam >= 0) && (startLine > writeRam));
+}
+
+
+/* checkWrap --- send a dirty range that wraps, and check that only its rows go */
+
+static void checkWrap(const int y1, const int y2, const int rows)
+{
+   const uint32_t pixels = Oled.pixels;
+   const uint32_t windows = Oled.windows;
+
+   markDirty(0, y1, MAXX - 1, y1);
+   markDirty(0, y2, MAXX - 1, y2);
+
+   updDirty();
+   updscreenWait();
+
+   CHECK((Oled.pixels - pixels) == (uint32_t)(rows * MAXX));
+   CHECK((Oled.windows - windows) == 2);
+}
+
+
+/* sentCommand --- return true if a command has been sent since the trace was reset */
+
+static bool sentCommand(const uint8_t c)
+{
+   uint32_t i;
+
+   for (i = 0; i < SimTraceLen; i++)
+      if (SimTrace[i] == c)
+         return (true);
+
+   return (false);
+}
+
+
+/* checkMarquee --- set a band scrolling, and check its commands and the updates around it */
+
+static void checkMarquee(void)
+{
+   const uint8_t args[5] = {1, 96, 32, 0x00, 1};
+   uint32_t pixels;
+   int y;
+   bool ok = true;
+
+   renderBitmap(0, 96, 128, 32, &OLEDImage[0][0], 128, SSD1351_MAGENTA, SSD1351_BLACK);
+   marqueeStart(96, 32, 1);
+
+   CHECK(Oled.scrolling);
+   CHECK(memcmp(Oled.scroll, args, sizeof (args)) == 0);
+
+   // Above the band, which needn't be sent again or stop scrolling
+   pixels = Oled.pixels;
+   simTraceReset();
+
+   fillRect(0, 32, 127, 63, SSD1351_WHITE, SSD1351_BLACK);
+   updDirty();
+
+   CHECK(updscreenBusy());
+   updscreenWait();
+   simSettle();
+
+   CHECK(Oled.scrolling);
+   CHECK(!sentCommand(SSD1351_STOPSCROLL));
+   CHECK((Oled.pixels - pixels) == (32 * MAXX));
+
+   // Inside the band, which goes again in full
+   pixels = Oled.pixels;
+
+   setPixel(10, 100, SSD1351_RED);
+   updDirty();
+   updscreenWait();
+
+   CHECK(Oled.scrolling);
+   CHECK((Oled.pixels - pixels) == (32 * MAXX));
+
+   for (y = 32; y < MAXY; y++)
+      ok &= (simScreen(0, y) == rgb(Frame[y][0])) && (simScreen(127, y) == rgb(Frame[y][127]));
+
+   CHECK(ok);
+
+   // Speed 0 would be the controller's test mode, and the band can't run off the bottom
+   marqueeStart(120, 20, 0);
+   CHECK((MarqueeTop == 120) && (MarqueeRows == 8) && (MarqueeSpeed == 1));
+   CHECK((Oled.scroll[1] == 120) && (Oled.scroll[2] == 8) && (Oled.scroll[4] == 1));
+
+   marqueeStart(0, MAXY, 9);
+   CHECK((MarqueeRows == MAXY) && (MarqueeSpeed == 3));
+
+   marqueeStart(MAXY, 4, 1);
+   CHECK(MarqueeRows == 0);
+   CHECK(!Oled.scrolling);
+
+   marqueeStart(96, 32, 2);
+   marqueeStop();
+   updscreenWait();
+
+   CHECK(!Oled.scrolling);
+   CHECK(screenIsFrame());
+}
+
+
+int main(void)
+{
+   int i;
+   int x1, x2;
+   uint32_t pixels;
+   bool ok = true, cheap = true, inOrder = true;
+
+   simBegin();
+
+   initSPI();
+   initDMA();
+
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+
+   OLED_begin(MAXX, MAXY);
+
+   greyFrame();
+   updscreen(0, MAXY - 1);
+
+   for (i = 0; i < NLINES; i++) {
+      x1 = (i * 7) % MAXX;
+      x2 = (i * 13) % MAXX;
+
+      pixels = Oled.pixels;
+      simTraceReset();
+
+      stripChart(x1, x2);
+      updscreenWait();
+      simSettle();
+
+      inOrder &= startLineLast();
+      cheap &= ((Oled.pixels - pixels) == MAXX);
+      ok &= screenIsFrame();
+
+      // The new line is at the bottom of the screen, and the one before just above it
+      if (x1 != x2)
+         ok &= (simScreen(x1, MAXY - 1) == rgb(colourIndex(SSD1351_BLUE)));
+
+      ok &= (simScreen(x2, MAXY - 1) == rgb(colourIndex(SSD1351_YELLOW)));
+
+      if (i > 0)
+         ok &= (simScreen(((i - 1) * 13) % MAXX, MAXY - 2) == rgb(colourIndex(SSD1351_YELLOW)));
+   }
+
+   CHECK(inOrder);
+   CHECK(cheap);
+   CHECK(ok);
+
+   // Commands that draw at fixed rows are turned away while scrolled
+   CHECK(drawsOnFrame('r') && drawsOnFrame('7') && drawsOnFrame('\r'));
+   CHECK(!drawsOnFrame('m') && !drawsOnFrame('^') && !drawsOnFrame('\0'));
+
+   // Damage either side of the bottom of the buffer goes as two windows
+   checkWrap(MAXY - 2, 1, 4);
+   checkWrap(MAXY - 1, 0, 2);
+   CHECK(screenIsFrame());
+
+   // Back to an unscrolled, blank screen
+   scrollReset();
+   updscreenWait();
+
+   CHECK(ScrollTop == 0);
+   CHECK(Oled.startLine == 0);
+   CHECK(screenIsFrame());
+   CHECK(simScreen(0, 0) == rgb(0));
+
+   checkMarquee();
+
+   return (simReport("scrolltest"));
+}
@@ -73,6 +73,18 @@
 #define PANAPLEX_COLOUR        (SSD1351_RED | 0x03e0)
 #define PETROL_STATION_COLOUR  SSD1351_RED   // But some petrol stations use green
 
+#define USE_SPI_DMA             // Send pixels by DMA, otherwise by a polled loop
+//#define INDEXED_FRAME         // 8-bit palette indices in the frame buffer, halving its size
+
+#define CPU_CLOCK_HZ  (100000000)
+#define SPI_CLOCK_HZ  (CPU_CLOCK_HZ / 8)
+
+#define CMD_BUFFER_SIZE  (32)
+
+#ifndef BENCH_LOOPS
+#define BENCH_LOOPS  (16)      // Full-screen fills per primitive for the '!' benchmark
+#endif
+
 #define UART_RX_BUFFER_SIZE  (128)
 #define UART_RX_BUFFER_MASK (UART_RX_BUFFER_SIZE - 1)
 #if (UART_RX_BUFFER_SIZE & UART_RX_BUFFER_MASK) != 0
@@ -105,6 +117,24 @@ struct UART_BUFFER
     struct UART_RX_BUFFER rx;
 };
 
+// SSD1351 commands and their arguments, waiting to be sent. Each entry
+// is the command byte, a count of argument bytes, then the arguments
+struct CMD_BUFFER
+{
+    uint8_t len;
+    uint8_t buf[CMD_BUFFER_SIZE];
+};
+
+// One pixel in the frame buffer
+#ifdef INDEXED_FRAME
+typedef uint8_t pixel_t;
+#else
+typedef uint16_t pixel_t;
+#endif
+
+// A word of pixels, for filling the frame buffer 32 bits at a time
+typedef uint32_t __attribute__((may_alias)) pixword_t;
+
 // What style digits would we prefer?
 enum STYLE {
    PANAPLEX_STYLE,
@@ -118,7 +148,8 @@ enum STYLE {
 enum MODE {
    MANUAL_MODE,
    AUTO_HMS_MODE,
-   AUTO_HEX_MODE
+   AUTO_HEX_MODE,
+   STRIP_CHART_MODE
 };
 
 // What state is the command parser operating in?
@@ -135,8 +166,51 @@ enum STATE {
 // UART buffers
 struct UART_BUFFER U1Buf;
 
+// OLED command buffer
+struct CMD_BUFFER CmdBuf;
+
+// A rectangle of pixels, used for tracking damage to the frame buffer
+struct RECT
+{
+    uint8_t x1;
+    uint8_t y1;
+    uint8_t x2;
+    uint8_t y2;
+};
+
+#ifdef INDEXED_FRAME
+// The frame buffer of palette indices, 16k bytes
+pixel_t Frame[MAXY][MAXX];
+
+// RGB565 colour sent to the OLED for each palette index
+uint16_t Palette[256];
+
+// Rows of 'Frame' expanded through the palette, ready for DMA
+uint16_t LineBuf[2][MAXX];
+#else
 // The colour frame buffer, 32k bytes
-uint16_t Frame[MAXY][MAXX];
+pixel_t Frame[MAXY][MAXX];
+#endif
+
+// Area of the frame buffer drawn into since the last screen update. Empty when x1 > x2.
+// Rows wrap from the bottom of the buffer to the top when y1 > y2
+struct RECT Dirty = {MAXX - 1, MAXY - 1, 0, 0};
+
+// Row of 'Frame' (and of OLED RAM) currently shown at the top of the screen
+uint8_t ScrollTop = 0;
+int StartLinePending = 0;    // ScrollTop has moved, but the OLED hasn't been told
+
+// Band of rows being scrolled sideways by the OLED controller. None when MarqueeRows == 0
+uint8_t MarqueeTop = 0;
+uint8_t MarqueeRows = 0;
+uint8_t MarqueeSpeed;
+
+// Window being sent to the screen by DMA, one row per transfer unless full width
+volatile uint8_t XferRow;
+uint8_t XferLastRow;
+uint8_t XferBottom;     // Last row of the window, even when sent in one transfer
+uint8_t XferX1;
+uint8_t XferWidth;
 
 volatile uint32_t Milliseconds = 0;
 volatile uint8_t Tick = 0;
@@ -144,6 +218,7 @@ volatile uint8_t RtcTick = 0;
 volatile uint8_t Hour = 0;
 volatile uint8_t Minute = 0;
 volatile uint8_t Second = 0;
+volatile uint8_t SpiDmaBusy = 0;
 
 
 /* USART1_IRQHandler --- ISR for USART1, used for Rx and Tx */
@@ -293,105 +368,507 @@ static void spi_dc(const int dc)
 }
 
 
-static uint8_t spi_txd(const uint8_t data)
+/* spi_tx --- send a byte or word by SPI without waiting for it to go */
+
+static inline void spi_tx(const uint16_t data)
 {
+   // The OLED never sends anything back, so we only wait for room in the
+   // Tx buffer. That keeps the shift register fed with no gaps between words
+   while ((SPI1->SR & SPI_SR_TXE) == 0)
+      ;
+   
    SPI1->DR = data;
+}
+
+
+/* spi_drain --- wait for SPI to finish sending and discard any Rx data */
+
+static void spi_drain(void)
+{
+   volatile uint16_t __attribute__((unused)) junk;
    
    while ((SPI1->SR & SPI_SR_TXE) == 0)
       ;
-      
-   while ((SPI1->SR & SPI_SR_RXNE) == 0)
+   
+   while (SPI1->SR & SPI_SR_BSY)
       ;
+   
+   // Nobody read the Rx data, so clear RXNE and OVR
+   junk = SPI1->DR;
+   junk = SPI1->SR;
+}
+
+
+/* colourIndex --- return the frame buffer pixel value for an RGB565 colour */
+
+static pixel_t colourIndex(const uint16_t c)
+{
+#ifdef INDEXED_FRAME
+    // The default palette is 3/3/2 bits of each 5/6/5 colour field
+    return (((c >> 8) & 0xE0) | ((c >> 6) & 0x1C) | ((c >> 3) & 0x03));
+#else
+    return (c);
+#endif
+}
+
+
+/* fillPattern --- fill a run of pixels with two alternating values, a word at a time */
+
+static void __attribute__((optimize("O3"))) fillPattern(pixel_t *dst, int n, pixel_t p0, pixel_t p1)
+{
+    pixword_t *w;
+    uint32_t word;
+    pixel_t t;
+    
+    // Ragged start, one pixel at a time up to a word boundary
+    while ((n > 0) && (((uintptr_t)dst & 3) != 0)) {
+        *dst++ = p0;
+        n--;
+        t = p0;
+        p0 = p1;
+        p1 = t;
+    }
+    
+#ifdef INDEXED_FRAME
+    word = p0 | (p1 << 8);
+    word |= word << 16;
+#else
+    word = p0 | ((uint32_t)p1 << 16);
+#endif
+    
+    // Four words per loop, which GCC can make into multiple-register stores.
+    // A word holds an even number of pixels, so the pattern stays in step
+    w = (pixword_t *)dst;
+    
+    for ( ; n >= (int)(16 / sizeof (pixel_t)); n -= 16 / sizeof (pixel_t)) {
+        w[0] = word;
+        w[1] = word;
+        w[2] = word;
+        w[3] = word;
+        w += 4;
+    }
+    
+    for ( ; n >= (int)(4 / sizeof (pixel_t)); n -= 4 / sizeof (pixel_t))
+        *w++ = word;
+    
+    // Ragged end
+    for (dst = (pixel_t *)w; n > 0; n--) {
+        *dst++ = p0;
+        t = p0;
+        p0 = p1;
+        p1 = t;
+    }
+}
+
+
+#if defined(INDEXED_FRAME) && defined(USE_SPI_DMA)
+/* expandRow --- convert part of a row of palette indices to RGB565 for sending */
+
+static void __attribute__((optimize("O3"))) expandRow(uint16_t *line, const int y, const int x1, const int width)
+{
+    const pixel_t *p = &Frame[y][x1];
+    int x;
+    
+    for (x = 0; x < width; x++)
+        line[x] = Palette[p[x]];
+}
+#endif
+
+
+#ifdef USE_SPI_DMA
+/* DMA2_Stream3_IRQHandler --- ISR for DMA2 Stream 3, used for SPI1 Tx */
+
+void DMA2_Stream3_IRQHandler(void)
+{
+   if (DMA2->LISR & DMA_LISR_TCIF3) {
+      DMA2->LIFCR = DMA_LIFCR_CTCIF3;    // Clear transfer complete flag
+      
+      if (XferRow < XferLastRow) {
+         // Feed the next row of a narrow window; CS stays low and the
+         // OLED wraps to the next row of its window by itself
+         XferRow++;
+         
+#ifdef INDEXED_FRAME
+         // This row was expanded while the last one was going out
+         DMA2_Stream3->M0AR = (uint32_t)&LineBuf[XferRow & 1][0];
+         DMA2_Stream3->NDTR = XferWidth;
+         DMA2_Stream3->CR |= DMA_SxCR_EN;
+         
+         // Expand the next into the buffer we've just finished with
+         if (XferRow < XferLastRow)
+            expandRow(LineBuf[(XferRow + 1) & 1], XferRow + 1, XferX1, XferWidth);
+#else
+         DMA2_Stream3->M0AR = (uint32_t)&Frame[XferRow][XferX1];
+         DMA2_Stream3->NDTR = XferWidth;
+         DMA2_Stream3->CR |= DMA_SxCR_EN;
+#endif
+         
+         return;
+      }
       
-   return (SPI1->DR);
+      // DMA has finished feeding SPI1, but the last word may still be shifting out
+      spi_drain();
+      
+      spi_cs(1);
+      SPI1->CR1 &= ~SPI_CR1_DFF;    // Back to 8-bit mode
+      
+      SpiDmaBusy = 0;
+   }
 }
+#endif
 
 
-/* oledCmd --- send a command byte to the OLED by SPI */
+/* updscreenBusy --- return true if a DMA screen update is still in progress */
 
-static void oledCmd(const uint8_t c)
+static int updscreenBusy(void)
 {
-   spi_dc(0);
-   spi_cs(0);
-   spi_txd(c);
-   spi_cs(1);
-   spi_dc(1);
+    return (SpiDmaBusy);
 }
 
 
-/* oledCmd1b --- send two command bytes to the OLED by SPI */
+/* updscreenWait --- wait for any DMA screen update to finish */
 
-static void oledCmd1b(const uint8_t c, const uint8_t b)
+static void updscreenWait(void)
 {
-   spi_dc(0);
-   spi_cs(0);
-   spi_txd(c);
-   spi_dc(1);
-   spi_txd(b);
-   spi_cs(1);
+    while (SpiDmaBusy)
+        ;
 }
 
 
-/* oledCmd2b --- send three command bytes to the OLED by SPI */
+/* cmdFlush --- send all queued commands to the OLED in a single transaction */
 
-static void oledCmd2b(const uint8_t c, const uint8_t b1, const uint8_t b2)
+static void cmdFlush(const int dataFollows)
 {
-   spi_dc(0);
+   int i, n;
+   
+   updscreenWait();    // SPI1 may still be busy with pixels
+   
    spi_cs(0);
-   spi_txd(c);
-   spi_dc(1);
-   spi_txd(b1);
-   spi_txd(b2);
-   spi_cs(1);
+   
+   for (i = 0; i < CmdBuf.len; ) {
+      // DC must not change until the previous byte has left the shift register
+      spi_drain();
+      spi_dc(0);
+      spi_tx(CmdBuf.buf[i++]);
+      spi_drain();
+      spi_dc(1);
+      
+      for (n = CmdBuf.buf[i++]; n > 0; n--)
+         spi_tx(CmdBuf.buf[i++]);
+   }
+   
+   spi_drain();
+   
+   CmdBuf.len = 0;
+   
+   // Leave CS low if the caller is about to send pixel data
+   if (!dataFollows)
+      spi_cs(1);
 }
 
 
-/* oledCmd3b --- send four command bytes to the OLED by SPI */
+/* cmdPut --- add a command and its arguments to the command buffer */
 
-static void oledCmd3b(const uint8_t c, const uint8_t b1, const uint8_t b2, const uint8_t b3)
+static void cmdPut(const uint8_t c, const int n, const uint8_t b1, const uint8_t b2, const uint8_t b3)
 {
-   spi_dc(0);
-   spi_cs(0);
-   spi_txd(c);
-   spi_dc(1);
-   spi_txd(b1);
-   spi_txd(b2);
-   spi_txd(b3);
-   spi_cs(1);
+   if ((CmdBuf.len + n + 2) > CMD_BUFFER_SIZE)
+      cmdFlush(0);
+   
+   CmdBuf.buf[CmdBuf.len++] = c;
+   CmdBuf.buf[CmdBuf.len++] = n;
+   
+   if (n > 0)
+      CmdBuf.buf[CmdBuf.len++] = b1;
+   
+   if (n > 1)
+      CmdBuf.buf[CmdBuf.len++] = b2;
+   
+   if (n > 2)
+      CmdBuf.buf[CmdBuf.len++] = b3;
 }
 
 
+/* cmdQueue --- queue a command byte for the OLED */
 
-/* updscreen --- update the physical screen from the buffer */
+static void cmdQueue(const uint8_t c)
+{
+   cmdPut(c, 0, 0, 0, 0);
+}
 
-static void __attribute__((optimize("O3"))) updscreen(const uint8_t y1, const uint8_t y2)
+
+/* cmdQueue1b --- queue a command byte and one argument for the OLED */
+
+static void cmdQueue1b(const uint8_t c, const uint8_t b)
 {
-    int x, y;
-    volatile uint16_t __attribute__((unused)) junk;
+   cmdPut(c, 1, b, 0, 0);
+}
+
+
+/* cmdQueue2b --- queue a command byte and two arguments for the OLED */
+
+static void cmdQueue2b(const uint8_t c, const uint8_t b1, const uint8_t b2)
+{
+   cmdPut(c, 2, b1, b2, 0);
+}
+
+
+/* cmdQueue3b --- queue a command byte and three arguments for the OLED */
+
+static void cmdQueue3b(const uint8_t c, const uint8_t b1, const uint8_t b2, const uint8_t b3)
+{
+   cmdPut(c, 3, b1, b2, b3);
+}
+
+
+/* cmdQueue5b --- queue a command byte and five arguments for the OLED */
+
+static void cmdQueue5b(const uint8_t c, const uint8_t b1, const uint8_t b2, const uint8_t b3, const uint8_t b4, const uint8_t b5)
+{
+   cmdPut(c, 5, b1, b2, b3);    // Makes room for all five
+   
+   CmdBuf.buf[CmdBuf.len++] = b4;
+   CmdBuf.buf[CmdBuf.len++] = b5;
+}
+
+
+/* updWindowAsync --- start sending a window of the buffer to the screen */
+
+static void __attribute__((optimize("O3"))) updWindowAsync(const uint8_t x1, const uint8_t y1, const uint8_t x2, const uint8_t y2)
+{
+    // Window and WRITERAM go in one transaction, leaving CS low for the pixels
+    cmdQueue2b(SSD1351_SETCOLUMN, x1, x2);
+    cmdQueue2b(SSD1351_SETROW, y1, y2);
     
-    oledCmd2b(SSD1351_SETCOLUMN, 0, MAXX - 1);
-    oledCmd2b(SSD1351_SETROW, y1, y2);
+    cmdQueue(SSD1351_WRITERAM);
     
-    oledCmd(SSD1351_WRITERAM);
+    cmdFlush(1);   // Waits for any DMA transfer still in flight
     
     SPI1->CR1 |= SPI_CR1_DFF;    // 16-bit mode for just a bit more speed
-    spi_cs(0);
+    
+#ifdef USE_SPI_DMA
+    XferX1 = x1;
+    XferWidth = (x2 - x1) + 1;
+    XferRow = y1;
+    XferBottom = y2;
+    
+#ifdef INDEXED_FRAME
+    // Rows go one at a time from a pair of line buffers, expanding
+    // each through the palette while the one before is sent
+    XferLastRow = y2;
+    DMA2_Stream3->NDTR = XferWidth;
+    
+    expandRow(LineBuf[y1 & 1], y1, x1, XferWidth);
+    
+    if (y1 < y2)
+        expandRow(LineBuf[(y1 + 1) & 1], y1 + 1, x1, XferWidth);
+#else
+    if (XferWidth == MAXX) {
+        // Full-width rows of 'Frame' are contiguous, so send them all at once
+        XferLastRow = y1;
+        DMA2_Stream3->NDTR = ((y2 - y1) + 1) * MAXX;
+    }
+    else {
+        XferLastRow = y2;
+        DMA2_Stream3->NDTR = XferWidth;
+    }
+#endif
+    
+    SpiDmaBusy = 1;
+    
+    DMA2->LIFCR = DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3;
+#ifdef INDEXED_FRAME
+    DMA2_Stream3->M0AR = (uint32_t)&LineBuf[y1 & 1][0];
+#else
+    DMA2_Stream3->M0AR = (uint32_t)&Frame[y1][x1];
+#endif
+    DMA2_Stream3->CR |= DMA_SxCR_EN;
+#else
+    int x, y;
     
     for (y = y1; y <= y2; y++)
-        for (x = 0; x < MAXX; x++) {
-            SPI1->DR = Frame[y][x];
-   
-            while ((SPI1->SR & SPI_SR_TXE) == 0)
-               ;
-      
-            while ((SPI1->SR & SPI_SR_RXNE) == 0)
-               ;
-      
-            junk = SPI1->DR;
-        }
-     
+        for (x = x1; x <= x2; x++)
+#ifdef INDEXED_FRAME
+            spi_tx(Palette[Frame[y][x]]);
+#else
+            spi_tx(Frame[y][x]);
+#endif
+    
+    spi_drain();
+    
     spi_cs(1);
     SPI1->CR1 &= ~SPI_CR1_DFF;    // Back to 8-bit mode
+#endif
+}
+
+
+/* ringRows --- widen a range of rows to take in rows 'y1' to 'y2' */
+
+static void ringRows(struct RECT *r, const unsigned int y1, const unsigned int y2)
+{
+    // When the screen is scrolled, the rows of the frame buffer form a
+    // ring and the range may wrap from the bottom to the top (y1 > y2).
+    // Grow it whichever way round gives the fewer rows, so that a new
+    // line at the bottom of a scrolled screen doesn't take in the lot
+    const unsigned int len = ((MAXY + r->y2 - r->y1) % MAXY) + 1;
+    const unsigned int start = (MAXY + y1 - r->y1) % MAXY;   // New rows, counted from the start of the range
+    const unsigned int end = start + (y2 - y1);
+    unsigned int fwd, back;
+    
+    fwd = end + 1;                  // Keep the start of the range and extend its end
+    
+    if (fwd < len)
+        fwd = len;
+    
+    back = (MAXY + len) - start;    // Or start at 'y1' and run on to the old end
+    
+    if (back < ((y2 - y1) + 1))
+        back = (y2 - y1) + 1;
+    
+    if ((fwd >= MAXY) && (back >= MAXY)) {    // All of them
+        r->y1 = 0;
+        r->y2 = MAXY - 1;
+    }
+    else if (fwd <= back)
+        r->y2 = (r->y1 + fwd - 1) % MAXY;
+    else {
+        r->y1 = y1;
+        r->y2 = (y1 + back - 1) % MAXY;
+    }
+}
+
+
+/* markDirty --- record that a rectangle of the buffer is about to be drawn into */
+
+static void markDirty(const unsigned int x1, const unsigned int y1, const unsigned int x2, const unsigned int y2)
+{
+#ifdef USE_SPI_DMA
+    // DMA may still be reading these rows for the last update, so wait
+    // for it to get past them rather than tear the picture on the screen.
+    // Rows above XferRow have gone (or been expanded into LineBuf)
+    while (SpiDmaBusy && (y1 <= XferBottom) && (y2 >= XferRow))
+        ;
+#endif
+    
+    if (Dirty.x1 > Dirty.x2) {    // Nothing else drawn yet
+        Dirty.x1 = x1;
+        Dirty.y1 = y1;
+        Dirty.x2 = x2;
+        Dirty.y2 = y2;
+        return;
+    }
+    
+    if (x1 < Dirty.x1)
+        Dirty.x1 = x1;
+        
+    if (x2 > Dirty.x2)
+        Dirty.x2 = x2;
+    
+    ringRows(&Dirty, y1, y2);
+}
+
+
+/* marqueeQueue --- queue the commands that set the marquee band scrolling */
+
+static void marqueeQueue(void)
+{
+   // Offset 1 moves the band one column per step, towards SEG127
+   cmdQueue5b(SSD1351_HORIZSCROLL, 1, MarqueeTop, MarqueeRows, 0x00, MarqueeSpeed);
+   cmdQueue(SSD1351_STARTSCROLL);
+}
+
+
+/* updRing --- start sending a window whose rows may wrap from the bottom of the buffer to the top */
+
+static void updRing(const struct RECT *r)
+{
+    if (r->y1 > r->y2) {
+        // Two windows, the second starting when the first has gone
+        updWindowAsync(r->x1, r->y1, r->x2, MAXY - 1);
+        updWindowAsync(r->x1, 0, r->x2, r->y2);
+    }
+    else
+        updWindowAsync(r->x1, r->y1, r->x2, r->y2);
+}
+
+
+/* startLineQueue --- queue the start line, if scrolling has moved it */
+
+static void startLineQueue(void)
+{
+    if (StartLinePending) {
+        cmdQueue1b(SSD1351_STARTLINE, ScrollTop);
+        StartLinePending = 0;
+    }
+}
+
+
+/* updDirty --- start sending just the damaged part of the buffer to the screen */
+
+static void updDirty(void)
+{
+    struct RECT r = Dirty;
+    int inBand = 0;    // Update touches the marquee band
+    
+    if (r.x1 > r.x2) {  // Nothing drawn since last time?
+        startLineQueue();
+        
+        if (CmdBuf.len > 0)
+            cmdFlush(0);    // But there may be a scroll waiting to go
+            
+        return;
+    }
+    
+    Dirty.x1 = MAXX - 1;
+    Dirty.y1 = MAXY - 1;
+    Dirty.x2 = 0;
+    Dirty.y2 = 0;
+    
+    if (MarqueeRows > 0) {
+        if (r.y1 <= r.y2)
+            inBand = (r.y1 < (MarqueeTop + MarqueeRows)) && (r.y2 >= MarqueeTop);
+        else    // Wrapped, so rows 'y1' to the bottom and the top to 'y2'
+            inBand = (r.y1 < (MarqueeTop + MarqueeRows)) || (r.y2 >= MarqueeTop);
+    }
+    
+    if (inBand) {
+        // The band's RAM mustn't be written while it's scrolling, so stop
+        // it for the update, then wait for the pixels to go before setting
+        // it scrolling again. The controller shifts its own RAM as it
+        // scrolls, so rewrite the whole of the band. Updates that miss the
+        // band leave it running and don't wait
+        cmdQueue(SSD1351_STOPSCROLL);
+        
+        r.x1 = 0;
+        r.x2 = MAXX - 1;
+        
+        ringRows(&r, MarqueeTop, MarqueeTop + MarqueeRows - 1);
+        
+        updRing(&r);
+        
+        startLineQueue();
+        marqueeQueue();
+        cmdFlush(0);
+    }
+    else {
+        updRing(&r);
+        
+        // The new start line mustn't show the rows until they've been
+        // written, so it waits for the pixels to go
+        if (StartLinePending) {
+            startLineQueue();
+            cmdFlush(0);
+        }
+    }
+}
+
+
+/* updscreen --- update the physical screen from the buffer */
+
+static void updscreen(const uint8_t y1, const uint8_t y2)
+{
+    markDirty(0, y1, MAXX - 1, y2);
+    updDirty();
+    updscreenWait();
 }
 
 
@@ -403,9 +880,11 @@ static void blitImg(const uint8_t x1, const uint8_t y1, const uint8_t wd, const
     const int x2 = x1 + wd - 1;
     const int y2 = y1 + ht - 1;
     
+    markDirty(x1, y1, x2, y2);
+    
     for (y = y1; y <= y2; y++)
         for (x = x1; x <= x2; x++)
-            Frame[y][x] = *image++;
+            Frame[y][x] = colourIndex(*image++);
 }
 
 
@@ -420,20 +899,22 @@ void videoWipe(const int state, const int mode, const uint16_t *image)
    case 0:
       y = 64 - state;
       image += y * 64;
+      
+      markDirty(32, y + 64, 32 + 64 - 1, y + 64);
    
       for (x = 32; x <= (32 + 64 - 1); x++)
-         Frame[y + 64][x] = *image++;
-      
+         Frame[y + 64][x] = colourIndex(*image++);
       break;
    case 1:
       x = 64 - state;
       image += x;
       
+      markDirty(x + 32, 64, x + 32, 64 + 64 - 1);
+      
       for (y = 0; y <= (64 - 1); y++) {
-         Frame[y + 64][x + 32] = *image;
+         Frame[y + 64][x + 32] = colourIndex(*image);
          image += 64;
       }
-      
       break;
    case 2:  // LFSR
       // 4096 states: 111000001000, 12, 11, 10, 4
@@ -449,51 +930,91 @@ void OLED_begin(const int wd, const int ht)
     uint8_t remap = 0x60;
     
     // Init sequence for SSD1351 128x128 colour OLED module
-    oledCmd1b(SSD1351_COMMANDLOCK, 0x12);
-    oledCmd1b(SSD1351_COMMANDLOCK, 0xB1);
-    
-    oledCmd(SSD1351_DISPLAYOFF);
-    
-    oledCmd1b(SSD1351_CLOCKDIV, 0xF1);
-    oledCmd1b(SSD1351_MUXRATIO, 127);
-    oledCmd1b(SSD1351_DISPLAYOFFSET, 0x0);
-    oledCmd1b(SSD1351_SETGPIO, 0x00);
-    oledCmd1b(SSD1351_FUNCTIONSELECT, 0x01);
-    oledCmd1b(SSD1351_PRECHARGE, 0x32);
-    oledCmd1b(SSD1351_VCOMH, 0x05);
-    oledCmd(SSD1351_NORMALDISPLAY);
-    oledCmd3b(SSD1351_CONTRASTABC, 0xC8, 0x80, 0xC8);
-    oledCmd1b(SSD1351_CONTRASTMASTER, 0x0F);
-    oledCmd3b(SSD1351_SETVSL, 0xA0, 0xB5, 0x55);
-    oledCmd1b(SSD1351_PRECHARGE2, 0x01);
+    cmdQueue1b(SSD1351_COMMANDLOCK, 0x12);
+    cmdQueue1b(SSD1351_COMMANDLOCK, 0xB1);
+    
+    cmdQueue(SSD1351_DISPLAYOFF);
+    
+    cmdQueue1b(SSD1351_CLOCKDIV, 0xF1);
+    cmdQueue1b(SSD1351_MUXRATIO, 127);
+    cmdQueue1b(SSD1351_DISPLAYOFFSET, 0x0);
+    cmdQueue1b(SSD1351_SETGPIO, 0x00);
+    cmdQueue1b(SSD1351_FUNCTIONSELECT, 0x01);
+    cmdQueue1b(SSD1351_PRECHARGE, 0x32);
+    cmdQueue1b(SSD1351_VCOMH, 0x05);
+    cmdQueue(SSD1351_NORMALDISPLAY);
+    cmdQueue3b(SSD1351_CONTRASTABC, 0xC8, 0x80, 0xC8);
+    cmdQueue1b(SSD1351_CONTRASTMASTER, 0x0F);
+    cmdQueue3b(SSD1351_SETVSL, 0xA0, 0xB5, 0x55);
+    cmdQueue1b(SSD1351_PRECHARGE2, 0x01);
     
     remap |= 0x10;   // Flip display vertically
     
-    oledCmd1b(SSD1351_SETREMAP, remap);
+    cmdQueue1b(SSD1351_SETREMAP, remap);
+    
+    cmdQueue(SSD1351_DISPLAYON); // Turn on OLED panel
+    
+    cmdFlush(0);
+}
+
+
+#ifdef INDEXED_FRAME
+/* setPalette --- change the colour shown for one palette index */
+
+void setPalette(const uint8_t index, const uint16_t c)
+{
+    // Pixels anywhere may use it, so the whole screen must be resent
+    markDirty(0, 0, MAXX - 1, MAXY - 1);
+    
+    Palette[index] = c;
+}
+
+
+/* setPaletteRange --- change the colours shown for a run of palette indices */
+
+void setPaletteRange(const uint8_t first, const int n, const uint16_t *colours)
+{
+    int i;
+    
+    markDirty(0, 0, MAXX - 1, MAXY - 1);
     
-    oledCmd(SSD1351_DISPLAYON); // Turn on OLED panel
+    for (i = 0; i < n; i++)
+        Palette[(first + i) & 0xFF] = colours[i];
 }
 
 
+/* initPalette --- set up the default palette to match colourIndex() */
+
+static void initPalette(void)
+{
+    int i;
+    
+    for (i = 0; i < 256; i++) {
+        const uint16_t hi = (i >> 5) & 0x07;
+        const uint16_t mid = (i >> 2) & 0x07;
+        const uint16_t lo = i & 0x03;
+        
+        // Replicate the top bits into the low bits so that 0 and full scale map exactly
+        Palette[i] = (((hi << 2) | (hi >> 1)) << 11) | (((mid << 3) | mid) << 5) | ((lo << 3) | (lo << 1) | (lo >> 1));
+    }
+}
+#endif
+
+
 /* greyFrame --- clear entire frame to checkerboard pattern */
 
 void greyFrame(void)
 {
-    int r, c;
+    int r;
+    const pixel_t black = colourIndex(SSD1351_BLACK);
+    const pixel_t white = colourIndex(SSD1351_WHITE);
 
+    markDirty(0, 0, MAXX - 1, MAXY - 1);
+    
     for (r = 0; r < MAXY; r += 2)
     {
-        for (c = 0; c < MAXX; c += 2)
-        {
-            Frame[r][c] = SSD1351_BLACK;
-            Frame[r][c + 1] = SSD1351_WHITE;
-        }
-        
-        for (c = 0; c < MAXX; c += 2)
-        {
-            Frame[r + 1][c] = SSD1351_WHITE;
-            Frame[r + 1][c + 1] = SSD1351_BLACK;
-        }
+        fillPattern(Frame[r], MAXX, black, white);
+        fillPattern(Frame[r + 1], MAXX, white, black);
     }
 }
 
@@ -502,8 +1023,10 @@ void greyFrame(void)
 
 void setPixel(const unsigned int x, const unsigned int y, const uint16_t c)
 {
-    if ((x < MAXX) && (y < MAXY))
-        Frame[y][x] = c;
+    if ((x < MAXX) && (y < MAXY)) {
+        markDirty(x, y, x, y);
+        Frame[y][x] = colourIndex(c);
+    }
     else
     {
 //      Serial.print("setPixel(");
@@ -520,20 +1043,144 @@ void setPixel(const unsigned int x, const unsigned int y, const uint16_t c)
 void setVline(const unsigned int x, const unsigned int y1, const unsigned int y2, const uint16_t c)
 {
     unsigned int y;
+    const pixel_t p = colourIndex(c);
 
+    markDirty(x, y1, x, y2);
+    
     for (y = y1; y <= y2; y++)
-        Frame[y][x] = c;
+        Frame[y][x] = p;
 }
 
 
 /* setHline --- set pixels in a horizontal line */
 
 void setHline(const unsigned int x1, const unsigned int x2, const unsigned int y, const uint16_t c)
+{
+    const pixel_t p = colourIndex(c);
+
+    markDirty(x1, y, x2, y);
+    
+    fillPattern(&Frame[y][x1], (x2 - x1) + 1, p, p);
+}
+
+
+/* scrollRow --- return the row of the frame buffer that appears at a given screen row */
+
+static unsigned int scrollRow(const unsigned int y)
+{
+    return ((y + ScrollTop) % MAXY);
+}
+
+
+/* scrollUp --- scroll the whole screen up, bringing 'n' new rows in at the bottom */
+
+void scrollUp(const unsigned int n, const uint16_t bg)
+{
+    // The frame buffer and OLED RAM are treated as a ring of rows, and
+    // SSD1351_STARTLINE chooses which row appears at the top of the
+    // screen. Scrolling just moves the start line; the rows that leave
+    // the top re-appear at the bottom, so we clear them for new content.
+    // The controller can only scroll all 128 rows together.
+    unsigned int i;
+    
+    for (i = 0; i < n; i++) {
+        setHline(0, MAXX - 1, ScrollTop, bg);
+        
+        ScrollTop = (ScrollTop + 1) % MAXY;
+    }
+    
+    // Goes out with the next updDirty(), after the new rows
+    StartLinePending = 1;
+}
+
+
+/* scrollReset --- put the screen back to an unscrolled view of a blank frame buffer */
+
+void scrollReset(void)
+{
+    // The frame buffer and OLED RAM are still rotated by ScrollTop rows,
+    // so the picture can't just be moved back; clear it instead. A blank
+    // screen looks the same whatever the start line
+    markDirty(0, 0, MAXX - 1, MAXY - 1);
+    memset(Frame, 0, sizeof (Frame));
+    
+    ScrollTop = 0;
+    StartLinePending = 1;
+    
+    updDirty();
+}
+
+
+/* stripChart --- scroll the screen and plot the next line of a strip chart */
+
+void stripChart(const unsigned int x1, const unsigned int x2)
 {
     unsigned int x;
+    unsigned int y;
+    
+    scrollUp(1, SSD1351_BLACK);
+    
+    y = scrollRow(MAXY - 1);    // The row that has just come in at the bottom
+    
+    for (x = 0; x < MAXX; x += MAXX / 4)
+        setPixel(x, y, SSD1351_GREY25);    // Graticule
+    
+    setPixel(x1, y, SSD1351_BLUE);
+    setPixel(x2, y, SSD1351_YELLOW);
+    
+    updDirty();
+}
+
 
-    for (x = x1; x <= x2; x++)
-        Frame[y][x] = c;
+/* marqueeStop --- stop the scrolling band and put it back where it was */
+
+void marqueeStop(void)
+{
+    if (MarqueeRows == 0)
+        return;
+    
+    cmdQueue(SSD1351_STOPSCROLL);
+    
+    // The band is left shifted in OLED RAM, so send it again
+    markDirty(0, MarqueeTop, MAXX - 1, MarqueeTop + MarqueeRows - 1);
+    
+    MarqueeRows = 0;
+    
+    updDirty();
+}
+
+
+/* marqueeStart --- set a band of the screen scrolling sideways */
+
+void marqueeStart(const unsigned int y, const unsigned int ht, const unsigned int speed)
+{
+    // The OLED controller does all the work, but it has to be stopped for
+    // every screen update, and the band resent if it has changed. 'speed'
+    // is 1 (fastest) to 3 (slowest); the controller's 0 is a test mode
+    if (MarqueeRows > 0)
+        marqueeStop();
+    
+    if ((ht == 0) || (y >= MAXY))
+        return;
+    
+    updDirty();    // Band content must be in OLED RAM before it moves
+    
+    MarqueeTop = y;
+    
+    if ((y + ht) > MAXY)
+        MarqueeRows = MAXY - y;    // Band stops at the bottom of the screen
+    else
+        MarqueeRows = ht;
+    
+    if (speed < 1)
+        MarqueeSpeed = 1;
+    else if (speed > 3)
+        MarqueeSpeed = 3;
+    else
+        MarqueeSpeed = speed;
+    
+    marqueeQueue();
+    cmdFlush(0);
 }
 
 
@@ -553,9 +1200,12 @@ void setRect(const int x1, const int y1, const int x2, const int y2, const uint1
 void fillRect(const int x1, const int y1, const int x2, const int y2, const uint16_t ec, const uint16_t fc)
 {
     int y;
+    const pixel_t p = colourIndex(fc);
 
+    markDirty(x1, y1, x2, y2);
+    
     for (y = y1; y <= y2; y++)
-        setHline(x1, x2, y, fc);
+        fillPattern(&Frame[y][x1], (x2 - x1) + 1, p, p);
 
     setHline(x1, x2, y1, ec);
     setVline(x2, y1, y2, ec);
@@ -573,15 +1223,19 @@ void renderBitmap(const int x1, const int y1, const int wd, const int ht, const
     const uint8_t *row;
     const int x2 = x1 + wd - 1;
     const int y2 = y1 + ht - 1;
+    const pixel_t fp = colourIndex(fg);
+    const pixel_t bp = colourIndex(bg);
+    
+    markDirty(x1, y1, x2, y2);
     
     for (y = y1, i = 0; y <= y2; y++, i++) {
         row = bitmap + (stride * (i / 8));
         
         for (x = x1, j = 0; x <= x2; x++, j++)
             if (row[j] & (1 << (i % 8)))
-                Frame[y][x] = fg;
+                Frame[y][x] = fp;
             else
-                Frame[y][x] = bg;
+                Frame[y][x] = bp;
     }
 }
 
@@ -1114,6 +1768,95 @@ void renderClockDisplay(const int width, const int style, const uint16_t c)
 }
 
 
+/* measureSPI --- time a full screen update and report the SPI throughput */
+
+void measureSPI(void)
+{
+   const uint32_t bits = MAXX * MAXY * 16;
+   uint32_t cycles;
+   uint32_t bps;
+   
+   updscreenWait();
+   
+   DWT->CYCCNT = 0;
+   
+   updscreen(0, MAXY - 1);
+   
+   cycles = DWT->CYCCNT;
+   bps = ((uint64_t)bits * CPU_CLOCK_HZ) / cycles;
+   
+   printf("SPI: %ld bits in %ld cycles = %ld bits/s, %ld%% of %ldHz\n", (long)bits, (long)cycles, (long)bps, (long)((bps * 100ull) / SPI_CLOCK_HZ), (long)SPI_CLOCK_HZ);
+}
+
+
+/* benchReport --- print the speed of one primitive from the benchmark */
+
+static void benchReport(const char *name, const uint32_t pixels, const uint32_t cycles)
+{
+   const uint64_t pps = ((uint64_t)pixels * CPU_CLOCK_HZ) / cycles;
+   
+   printf("%-16s %ld pixels in %ld cycles = %ld pixels/s\n", name, (long)pixels, (long)cycles, (long)pps);
+}
+
+
+/* benchFill --- time the fill primitives against a plain pixel-at-a-time loop */
+
+void benchFill(void)
+{
+   const uint32_t pixels = BENCH_LOOPS * MAXX * MAXY;
+   const pixel_t p = colourIndex(SSD1351_BLUE);
+   volatile pixel_t (*const frame)[MAXX] = Frame;
+   uint32_t before;
+   int i, x, y;
+   
+   updscreenWait();    // Keep DMA off the bus while we're timing
+   
+   // The way setHline() used to work, for comparison. Stores go through
+   // a volatile pointer, or GCC may turn the loop into a memset()
+   before = DWT->CYCCNT;
+   
+   for (i = 0; i < BENCH_LOOPS; i++)
+      for (y = 0; y < MAXY; y++)
+         for (x = 0; x < MAXX; x++)
+            frame[y][x] = p;
+   
+   benchReport("Pixel loop", pixels, DWT->CYCCNT - before);
+   
+   before = DWT->CYCCNT;
+   
+   for (i = 0; i < BENCH_LOOPS; i++)
+      for (y = 0; y < MAXY; y++)
+         setHline(0, MAXX - 1, y, SSD1351_GREEN);
+   
+   benchReport("setHline", pixels, DWT->CYCCNT - before);
+   
+   // Odd start and end, so both ragged edges are exercised
+   before = DWT->CYCCNT;
+   
+   for (i = 0; i < BENCH_LOOPS; i++)
+      for (y = 0; y < MAXY; y++)
+         setHline(1, MAXX - 2, y, SSD1351_RED);
+   
+   benchReport("setHline ragged", BENCH_LOOPS * (MAXX - 2) * MAXY, DWT->CYCCNT - before);
+   
+   before = DWT->CYCCNT;
+   
+   for (i = 0; i < BENCH_LOOPS; i++)
+      fillRect(0, 0, MAXX - 1, MAXY - 1, SSD1351_WHITE, SSD1351_BLUE);
+   
+   benchReport("fillRect", pixels, DWT->CYCCNT - before);
+   
+   before = DWT->CYCCNT;
+   
+   for (i = 0; i < BENCH_LOOPS; i++)
+      greyFrame();
+   
+   benchReport("greyFrame", pixels, DWT->CYCCNT - before);
+   
+   updDirty();
+}
+
+
 /* _write --- connect stdio functions to UART1 */
 
 int _write(const int fd, const char *ptr, const int len)
@@ -1210,6 +1953,9 @@ static void initMCU(void)
       ;
    
    RCC->CSR |= RCC_CSR_RMVF;
+   
+   CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;   // Enable the DWT cycle counter, for timing
+   DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 
@@ -1336,6 +2082,35 @@ static void initSPI(void)
 }
 
 
+#ifdef USE_SPI_DMA
+/* initDMA --- set up DMA for SPI1 Tx */
+
+static void initDMA(void)
+{
+   // Configure Reset and Clock Control
+   RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;                    // Enable clock to DMA2 controller on AHB1 bus
+   
+   // Set up DMA2 Stream 3 Channel 3, which is SPI1_TX
+   DMA2_Stream3->CR = 0;
+   
+   while (DMA2_Stream3->CR & DMA_SxCR_EN)
+      ;
+   
+   DMA2_Stream3->CR |= 3 << DMA_SxCR_CHSEL_Pos;           // Channel 3 is SPI1_TX
+   DMA2_Stream3->CR |= DMA_SxCR_MSIZE_0 | DMA_SxCR_PSIZE_0;  // 16-bit memory and peripheral
+   DMA2_Stream3->CR |= DMA_SxCR_MINC;                     // Increment memory address only
+   DMA2_Stream3->CR |= DMA_SxCR_DIR_0;                    // Memory-to-peripheral
+   DMA2_Stream3->CR |= DMA_SxCR_TCIE;                     // Interrupt on transfer complete
+   DMA2_Stream3->PAR = (uint32_t)&SPI1->DR;
+   DMA2_Stream3->FCR = 0;                                 // Direct mode, no FIFO
+   
+   SPI1->CR2 |= SPI_CR2_TXDMAEN;                          // Let SPI1 make DMA requests on Tx empty
+   
+   NVIC_EnableIRQ(DMA2_Stream3_IRQn);
+}
+#endif
+
+
 /* initADC --- set up the ADC */
 
 static void initADC(void)
@@ -1379,6 +2154,16 @@ static void initMillisecondTimer(void)
 }
 
 
+/* drawsOnFrame --- return true if a UART command draws at fixed rows of the frame buffer */
+
+static int drawsOnFrame(const uint8_t ch)
+{
+   // These use unscrolled frame buffer rows, so would land in the
+   // wrong place on the screen while the strip chart has it scrolled
+   return ((ch != '\0') && (strchr("rRqQ0123456789aAbBcCdDeEfFoO\r]{!.:t", ch) != NULL));
+}
+
+
 int main(void)
 {
    uint32_t end;
@@ -1400,6 +2185,9 @@ int main(void)
    initGPIOs();
    initUARTs();
    initSPI();
+#ifdef USE_SPI_DMA
+   initDMA();
+#endif
    initADC();
    initTimers();
    initMillisecondTimer();
@@ -1408,6 +2196,10 @@ int main(void)
    
    OLED_begin(MAXX, MAXY);
    
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+   
    greyFrame();
     
    updscreen(0, MAXY - 1);
@@ -1432,23 +2224,29 @@ int main(void)
             
             flag = !flag;
             
-            printf("millis() = %ld\n", millis());
+            printf("millis() = %lu\n", (unsigned long)millis());
          }
          
-         if (millis() >= frame) {
+         if ((millis() >= frame) && !updscreenBusy()) {
             frame = millis() + 40u;
             
             const uint16_t ana1 = analogRead(1) / 32;
             const uint16_t ana2 = analogRead(8) / 32;
-            fillRect(0, 32, 127, 63, SSD1351_WHITE, SSD1351_BLACK);
-            fillRect(1, 33, ana1, 47, SSD1351_BLUE, SSD1351_BLUE);
-            fillRect(1, 48, ana2, 62, SSD1351_BLUE, SSD1351_BLUE);
-            updscreen(32, 63);
             
-            if (wipeState > 0) {
-               videoWipe(wipeState, wipeMode, &Copen64[0][0]);
-               updscreen(64, 127);
-               wipeState--;
+            if (displayMode == STRIP_CHART_MODE) {
+               stripChart(ana1, ana2);
+            }
+            else {
+               fillRect(0, 32, 127, 63, SSD1351_WHITE, SSD1351_BLACK);
+               fillRect(1, 33, ana1, 47, SSD1351_BLUE, SSD1351_BLUE);
+               fillRect(1, 48, ana2, 62, SSD1351_BLUE, SSD1351_BLUE);
+               
+               if (wipeState > 0) {
+                  videoWipe(wipeState, wipeMode, &Copen64[0][0]);
+                  wipeState--;
+               }
+               
+               updDirty();
             }
          }
          
@@ -1456,7 +2254,7 @@ int main(void)
             drawSegCN(1 * width, style, colour);
             drawSegCN(3 * width, style, colour);
             
-            updscreen(0, 31);
+            updDirty();
             
             colon += 600u;
          }
@@ -1468,11 +2266,12 @@ int main(void)
          printf("RTC: %02d:%02d:%02d\n", Hour, Minute, Second);
          
          if (displayMode == AUTO_HMS_MODE) {
+            markDirty(0, 0, MAXX - 1, (MAXY / 4) - 1);
             memset(Frame, 0, sizeof (Frame) / 4);
             
             renderClockDisplay(width, style, colour);
             
-            updscreen(0, 31);
+            updDirty();
             
             colon = millis() + 500u;
          }
@@ -1538,11 +2337,16 @@ int main(void)
                state = NOT_SETTING_TIME;
             break;
          case NOT_SETTING_TIME:
+            if ((displayMode == STRIP_CHART_MODE) && drawsOnFrame(ch)) {
+               printf("Not while scrolling: 'm' ends the strip chart\n");
+               break;
+            }
+            
             switch (ch) {
             case 'r':
             case 'R':
                setRect(0, 0, MAXX - 1, MAXY - 1, SSD1351_WHITE);
-               updscreen(0, MAXY - 1);
+               updDirty();
                break;
             case 'q':
             case 'Q':
@@ -1552,7 +2356,7 @@ int main(void)
                setHline(0, MAXX - 1, MAXY / 4, SSD1351_WHITE);
                setHline(0, MAXX - 1, MAXY / 2, SSD1351_WHITE);
                setHline(0, MAXX - 1, (MAXY * 3) / 4, SSD1351_WHITE);
-               updscreen(0, MAXY - 1);
+               updDirty();
                break;
             case 'g':
                digit = 0;
@@ -1580,83 +2384,83 @@ int main(void)
                break;
             case '0':
                renderHexDigit(x, 0, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '1':
                renderHexDigit(x, 1, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '2':
                renderHexDigit(x, 2, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '3':
                renderHexDigit(x, 3, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '4':
                renderHexDigit(x, 4, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '5':
                renderHexDigit(x, 5, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '6':
                renderHexDigit(x, 6, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '7':
                renderHexDigit(x, 7, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '8':
                renderHexDigit(x, 8, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case '9':
                renderHexDigit(x, 9, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case 'a':
             case 'A':
                renderHexDigit(x, 0xA, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case 'b':
             case 'B':
                renderHexDigit(x, 0xB, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case 'c':
             case 'C':
                renderHexDigit(x, 0xC, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case 'd':
             case 'D':
                renderHexDigit(x, 0xD, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case 'e':
             case 'E':
                renderHexDigit(x, 0xE, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case 'f':
             case 'F':
                renderHexDigit(x, 0xF, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case 'o':
             case 'O':
                renderBitmap(0, 32, 128, 32, &OLEDImage[0][0], 128, SSD1351_BLUE, SSD1351_GREY25);
                renderBitmap(0, 64, 128, 32, &OLEDImage[0][0], 128, SSD1351_YELLOW, SSD1351_GREY50);
-               updscreen(32, 95);
+               updDirty();
                break;
             case '\r':
                renderBitmap(0, 64, 128, DIGIT_HEIGHT, &PetrolDigits[0][0], DIGIT_STRIDE, SSD1351_GREEN, SSD1351_BLACK);
-               updscreen(64, 95);
+               updDirty();
                break;
             case '[':
                wipeState = 64;
@@ -1668,7 +2472,7 @@ int main(void)
                break;
             case ']':
                blitImg(32, 64, 64, 64, &Copen64[0][0]);
-               updscreen(64, 127);
+               updDirty();
                break;
             case '{':
                for (hour = 0; hour < 32; hour++) {
@@ -1678,36 +2482,47 @@ int main(void)
                   setHline(96, 127, hour + 96, (hour << 11) | (hour << 6) | hour);
                }
                
-               updscreen(96, 127);
+               updDirty();
                break;
             case '/':
                printf("analogRead = %d, %d\n", analogRead(1), analogRead(8));
                break;
+            case 'p':
+            case 'P':
+               measureSPI();
+               break;
+            case '!':
+               benchFill();
+               break;
             case '.':
                drawSegDP(x, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case ':':
                drawSegCN(x, style, colour);
-               updscreen(0, 31);
+               updDirty();
                break;
             case 's':
                state = SETTING_TIME_1;
                printf("OLD: %02d:%02d:%02d\n", Hour, Minute, Second);
                break;
             case 't':
+               markDirty(0, 0, MAXX - 1, (MAXY / 4) - 1);
                memset(Frame, 0, sizeof (Frame) / 4);
                
                renderClockDisplay(width, style, colour);
                drawSegCN(1 * width, style, colour);
                drawSegCN(3 * width, style, colour);
                
-               updscreen(0, 31);
+               updDirty();
                
                colon = millis() + 1100u;
                break;
             case 'm':
             case 'M':
+               if (displayMode == STRIP_CHART_MODE)
+                  scrollReset();
+               
                displayMode = MANUAL_MODE;
                break;
             case 'n':
@@ -1717,8 +2532,27 @@ int main(void)
                break;
             case 'u':
             case 'U':
+               if (displayMode == STRIP_CHART_MODE)
+                  scrollReset();
+               
                displayMode = AUTO_HMS_MODE;
                break;
+            case '^':
+               marqueeStop();
+               displayMode = STRIP_CHART_MODE;
+               break;
+            case '>':
+               if (displayMode == STRIP_CHART_MODE) {
+                  scrollReset();
+                  displayMode = MANUAL_MODE;
+               }
+               
+               renderBitmap(0, 96, 128, 32, &OLEDImage[0][0], 128, SSD1351_MAGENTA, SSD1351_BLACK);
+               marqueeStart(96, 32, 1);
+               break;
+            case '<':
+               marqueeStop();
+               break;
             case 'v':
             case 'V':
                style = VFD_STYLE;
@@ -1741,8 +2575,9 @@ int main(void)
                break;
             case 'z':
             case 'Z':
+               markDirty(0, 0, MAXX - 1, MAXY - 1);
                memset(Frame, 0, sizeof (Frame));
-               updscreen(0, MAXY - 1);
+               updDirty();
                break;
             }
             break;
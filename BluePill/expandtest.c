@@ -0,0 +1,283 @@
+/* expandtest --- check the DMA screen update against the old per-pixel one */
+
+// Built for the host by 'make check', with the firmware included whole.
+// The frame buffer is filled with junk and sent to a simulated OLED by
+// both updscreen() and oldUpdscreen(), the per-pixel version it replaced.
+// The two must send the same bytes, and the OLED must end up showing the
+// frame buffer. With COLOUR_FRAME, spans with odd and even ends, single
+// pixels and pages of a bitmap are drawn over junk, and the OLED must
+// show them in the right colours with the pixels around them untouched,
+// before and after setPalette() changes some of the colours.
+
+#define main spi_oled_main
+#include "spi_oled.c"
+#undef main
+
+#include <stdlib.h>
+
+#include "oledsim.h"
+
+#ifdef COLOUR_FRAME
+uint8_t RefPen[MAXY][MAXX];      // Palette index that each pixel should have
+uint16_t RefPalette[16];         // RGB565 that each palette index should show
+#endif
+
+
+/* refPixel --- return the RGB565 colour of one pixel of the frame buffer */
+
+static uint16_t refPixel(const int x, const int y, const uint16_t colour)
+{
+#ifdef COLOUR_FRAME
+   return (Palette[(Frame[y][x / 2] >> ((x & 1) * 4)) & 0x0f]);
+#else
+   if (Frame[y / 8][x] & (1 << (y % 8)))
+      return (colour);
+   else
+      return (SSD1351_BLACK);
+#endif
+}
+
+
+/* oldUpdscreen --- update the physical screen a pixel at a time, as before DMA */
+
+static void oldUpdscreen(const uint8_t y1, const uint8_t y2, const uint16_t colour)
+{
+    int x, y;
+    volatile uint16_t __attribute__((unused)) junk;
+
+    oledCmd2b(SSD1351_SETCOLUMN, 0, MAXX - 1);
+    oledCmd2b(SSD1351_SETROW, y1, y2);
+
+    oledCmd(SSD1351_WRITERAM);
+
+    SPI1->CR1 |= SPI_CR1_DFF;    // 16-bit mode for just a bit more speed
+    spi_cs(0);
+
+    for (y = y1; y <= y2; y++)
+        for (x = 0; x < MAXX; x++) {
+            SPI1->DR = refPixel(x, y, colour);
+
+            while ((SPI1->SR & SPI_SR_TXE) == 0)
+               ;
+
+            while ((SPI1->SR & SPI_SR_RXNE) == 0)
+               ;
+
+            junk = SPI1->DR;
+        }
+
+    spi_cs(1);
+    SPI1->CR1 &= ~SPI_CR1_DFF;    // Back to 8-bit mode
+}
+
+
+/* junkFrame --- fill the frame buffer with random bytes */
+
+static void junkFrame(void)
+{
+   uint8_t *p = (uint8_t *)Frame;
+   size_t i;
+
+   for (i = 0; i < sizeof (Frame); i++)
+      p[i] = rand();
+}
+
+
+/* checkUpdate --- compare the bytes sent by the new and old updscreen() */
+
+static void checkUpdate(const int y1, const int y2, const uint16_t colour)
+{
+   static uint16_t before[SIM_TRACE_SIZE];
+   uint32_t n;
+   int x, y;
+   bool ok = true;
+
+   junkFrame();
+
+   simTraceReset();
+   oldUpdscreen(y1, y2, colour);
+   simSettle();
+
+   n = SimTraceLen;
+   memcpy(before, SimTrace, n * sizeof (SimTrace[0]));
+
+   memset(&Oled.ram, 0, sizeof (Oled.ram));
+
+   simTraceReset();
+   updscreen(y1, y2, colour);
+   simSettle();
+
+   CHECK(n == (7 + (((y2 - y1) + 1) * MAXX * 2)));
+   CHECK(SimTraceLen == n);
+   CHECK(memcmp(SimTrace, before, n * sizeof (SimTrace[0])) == 0);
+
+   for (y = y1; y <= y2; y++)
+      for (x = 0; x < MAXX; x++)
+         ok &= (Oled.ram[y][x] == refPixel(x, y, colour));
+
+   CHECK(ok);
+
+   // CS is up again and SPI1 is back in 8-bit mode for commands
+   CHECK((GPIOA->ODR & GPIO_BSRR_BS4) != 0);
+   CHECK((SPI1->CR1 & SPI_CR1_DFF) == 0);
+}
+
+
+#ifdef COLOUR_FRAME
+/* refSpan --- draw a span into the reference, one pixel at a time */
+
+static void refSpan(const int x1, const int x2, const int y, const uint8_t p)
+{
+   int x;
+
+   for (x = x1; x <= x2; x++)
+      RefPen[y][x] = p;
+}
+
+
+/* sameColours --- send the whole frame and return true if the OLED shows the reference */
+
+static bool sameColours(void)
+{
+   int x, y;
+   bool ok = true;
+
+   updscreen(0, MAXY - 1, SSD1351_BLACK);
+   simSettle();
+
+   for (y = 0; y < MAXY; y++)
+      for (x = 0; x < MAXX; x++)
+         ok &= (Oled.ram[y][x] == RefPalette[RefPen[y][x]]);
+
+   return (ok);
+}
+
+
+/* checkDrawing --- draw into the 4bpp frame and check the colours on the OLED */
+
+static void checkDrawing(void)
+{
+   static const uint8_t bitmap[3][21] = {
+      {0xff, 0x01, 0x80, 0x55, 0xaa, 0x0f, 0xf0, 0x00, 0x81, 0x42, 0x24, 0x18, 0x3c, 0x7e, 0xe7, 0xc3, 0x99, 0x66, 0x11, 0x22, 0x44},
+      {0x00, 0xff, 0x33, 0xcc, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0xfe, 0xfd, 0xfb, 0xf7, 0xef, 0xdf, 0xbf, 0x7f, 0x5a},
+      {0xa5, 0x96, 0x69, 0x00, 0xff, 0x18, 0x24, 0x42, 0x81, 0x3c, 0xc3, 0x0f, 0xf0, 0x55, 0xaa, 0x11, 0x88, 0x77, 0xee, 0x01, 0x80}
+   };
+   int x, y, i, j, x1, x2;
+
+   memcpy(RefPalette, Palette, sizeof (RefPalette));
+
+   junkFrame();
+
+   for (y = 0; y < MAXY; y++)
+      for (x = 0; x < MAXX; x++)
+         RefPen[y][x] = (Frame[y][x / 2] >> ((x & 1) * 4)) & 0x0f;
+
+   // Spans starting and ending on odd and even columns, one per row
+   for (y = 0; y < MAXY; y++) {
+      x1 = (y * 7) % MAXX;
+      x2 = x1 + ((y * 13) % (MAXX - x1));
+      Pen = (y % 15) + 1;
+
+      setHline(x1, x2, y);
+      refSpan(x1, x2, y, Pen);
+   }
+
+   // The ends of the screen, single pixels and two-pixel spans
+   Pen = 9;
+   setHline(0, MAXX - 1, 5);
+   refSpan(0, MAXX - 1, 5, Pen);
+
+   clrHline(0, 0, 6);
+   refSpan(0, 0, 6, 0);
+
+   clrHline(MAXX - 1, MAXX - 1, 7);
+   refSpan(MAXX - 1, MAXX - 1, 7, 0);
+
+   setHline(3, 4, 8);
+   refSpan(3, 4, 8, Pen);
+
+   setHline(6, 7, 9);
+   refSpan(6, 7, 9, Pen);
+
+   for (i = 0; i < 200; i++) {
+      x = (i * 37) % MAXX;
+      y = (i * 59) % MAXY;
+      Pen = i & 0x0f;
+
+      setPixel(x, y);
+      RefPen[y][x] = Pen;
+   }
+
+   // Pages of a bitmap, from an odd column
+   Pen = 4;
+   renderPages(11, 10, 21, 3, &bitmap[0][0], sizeof (bitmap[0]));
+
+   for (i = 0; i < 3; i++)
+      for (j = 0; j < 8; j++)
+         for (x = 0; x < 21; x++)
+            RefPen[((10 + i) * 8) + j][11 + x] = ((bitmap[i][x] >> j) & 1) ? Pen : 0;
+
+   CHECK(sameColours());
+
+   // The same frame, shown with new colours
+   setPalette(0, SSD1351_GREY25);
+   RefPalette[0] = SSD1351_GREY25;
+
+   setPalette(4, 0x1234);
+   RefPalette[4] = 0x1234;
+
+   setPalette(15, SSD1351_WHITE);
+   RefPalette[15] = SSD1351_WHITE;
+
+   CHECK(sameColours());
+}
+#endif
+
+
+int main(void)
+{
+   int y;
+   bool ok = true;
+
+   simBegin();
+
+   initSPI();
+   initDMA();
+
+#ifdef COLOUR_FRAME
+   buildPairLut();
+#endif
+
+   OLED_begin(MAXX, MAXY);
+
+   // expandLine() on its own, for every line
+   junkFrame();
+
+   for (y = 0; y < MAXY; y++) {
+      int x;
+
+#ifdef COLOUR_FRAME
+      expandLine(LineBuf[0], y);
+#else
+      expandLine(LineBuf[0], y, (const uint16_t[2]){SSD1351_BLACK, VFD_COLOUR});
+#endif
+
+      for (x = 0; x < MAXX; x++)
+         ok &= (LineBuf[0][x] == refPixel(x, y, VFD_COLOUR));
+   }
+
+   CHECK(ok);
+
+   // And sent to the OLED
+   checkUpdate(0, MAXY - 1, VFD_COLOUR);
+   checkUpdate(0, 0, LED_COLOUR);
+   checkUpdate(MAXY - 1, MAXY - 1, PANAPLEX_COLOUR);
+   checkUpdate(37, 90, SSD1351_WHITE);
+   checkUpdate(8, 9, SSD1351_BLACK);
+
+#ifdef COLOUR_FRAME
+   checkDrawing();
+#endif
+
+   return (simReport("expandtest"));
+}
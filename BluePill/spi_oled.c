@@ -64,12 +64,16 @@
 #define SSD1351_MAGENTA        (SSD1351_RED  | SSD1351_BLUE)
 #define SSD1351_YELLOW         (SSD1351_RED  | SSD1351_GREEN)
 #define SSD1351_WHITE          (SSD1351_RED  | SSD1351_GREEN | SSD1351_BLUE)
+#define SSD1351_GREY50         (0x000f | 0x03e0 | 0x7800)
+#define SSD1351_GREY25         (0x0007 | 0x01e0 | 0x3800)
 
 #define VFD_COLOUR             SSD1351_CYAN
 #define LED_COLOUR             SSD1351_RED
 #define PANAPLEX_COLOUR        (SSD1351_RED | 0x03e0)
 #define PETROL_STATION_COLOUR  SSD1351_RED   // But some petrol stations use green
 
+//#define COLOUR_FRAME          // 4 bits per pixel from a 16-colour palette, instead of 1
+
 #define UART_RX_BUFFER_SIZE  (128)
 #define UART_RX_BUFFER_MASK (UART_RX_BUFFER_SIZE - 1)
 #if (UART_RX_BUFFER_SIZE & UART_RX_BUFFER_MASK) != 0
@@ -132,8 +136,43 @@ enum STATE {
 // UART buffers
 struct UART_BUFFER U1Buf;
 
+#ifdef COLOUR_FRAME
+// The frame buffer, two 4-bit palette indices per byte with the left-hand
+// pixel in the low nibble, 8k bytes
+uint8_t Frame[MAXY][MAXX / 2];
+
+// RGB565 colour for each palette index
+uint16_t Palette[16] = {
+   SSD1351_BLACK,          // 0, also the background for clr*() primitives
+   SSD1351_RED,
+   SSD1351_GREEN,
+   SSD1351_BLUE,
+   SSD1351_CYAN,
+   SSD1351_MAGENTA,
+   SSD1351_YELLOW,
+   SSD1351_WHITE,
+   PANAPLEX_COLOUR,
+   SSD1351_GREY50,
+   SSD1351_GREY25,
+   0x0007 << 11 | 0x000f << 5,    // Dim cyan, like an unlit VFD segment
+   0x0007,                        // Dim red
+   0x000f << 5,                   // Dim green
+   0x0007 << 11,                  // Dim blue
+   0x0007 | 0x0007 << 5           // Dim orange
+};
+
+// Two RGB565 pixels for every possible byte of 'Frame', rebuilt when the palette changes
+uint32_t PairLut[256];
+
+// Palette index drawn by the set*() primitives
+uint8_t Pen = 7;
+#else
 // The frame buffer, 512 bytes
 uint8_t Frame[MAXROWS][MAXX];
+#endif
+
+// Two lines of RGB565 pixels; one is expanded while DMA sends the other
+uint16_t LineBuf[2][MAXX] __attribute__((aligned(4)));
 
 volatile uint32_t Milliseconds = 0;
 volatile uint8_t Tick = 0;
@@ -359,12 +398,43 @@ static void oledCmd3b(const uint8_t c, const uint8_t b1, const uint8_t b2, const
 
 
 
-/* updscreen --- update the physical screen from the buffer */
+#ifdef COLOUR_FRAME
+/* expandLine --- expand one line of the 4bpp frame buffer into RGB565 pixels */
+
+static void __attribute__((optimize("O3"))) expandLine(uint16_t *line, const int y)
+{
+    // Each byte of 'Frame' becomes two pixels in a single 32-bit store
+    int x;
+    const uint8_t *src = Frame[y];
+    uint32_t *dst = (uint32_t *)line;
+    
+    for (x = 0; x < (MAXX / 2); x++)
+        dst[x] = PairLut[src[x]];
+}
+#else
+/* expandLine --- expand one line of the 1bpp frame buffer into RGB565 pixels */
 
-static void __attribute__((optimize("O3"))) updscreen(const uint8_t y1, const uint8_t y2, const uint16_t colour)
+static void __attribute__((optimize("O3"))) expandLine(uint16_t *line, const int y, const uint16_t lut[2])
 {
-    int x, y;
-    uint16_t pixel;
+    int x;
+    const uint8_t *page = Frame[y / 8];
+    const int bit = y % 8;
+    
+    for (x = 0; x < MAXX; x++)
+        line[x] = lut[(page[x] >> bit) & 1];
+}
+#endif
+
+
+/* updscreen --- update the physical screen from the buffer, 'colour' being ignored in COLOUR_FRAME mode */
+
+static void updscreen(const uint8_t y1, const uint8_t y2, const uint16_t colour)
+{
+    int y;
+    int buf = 0;
+#ifndef COLOUR_FRAME
+    const uint16_t lut[2] = {SSD1351_BLACK, colour};   // Pixel off and on
+#endif
     volatile uint16_t __attribute__((unused)) junk;
     
     oledCmd2b(SSD1351_SETCOLUMN, 0, MAXX - 1);
@@ -375,26 +445,46 @@ static void __attribute__((optimize("O3"))) updscreen(const uint8_t y1, const ui
     SPI1->CR1 |= SPI_CR1_DFF;    // 16-bit mode for just a bit more speed
     spi_cs(0);
     
-    for (y = y1; y <= y2; y++)
-        for (x = 0; x < MAXX; x++) {
-            if (Frame[y / 8][x] & (1 << (y % 8))) {
-                pixel = colour;
-            }
-            else {
-                pixel = SSD1351_BLACK;
-            }
-            
-            SPI1->DR = pixel;
-   
-            while ((SPI1->SR & SPI_SR_TXE) == 0)
-               ;
-      
-            while ((SPI1->SR & SPI_SR_RXNE) == 0)
-               ;
-      
-            junk = SPI1->DR;
-        }
-     
+#ifdef COLOUR_FRAME
+    expandLine(LineBuf[buf], y1);
+#else
+    expandLine(LineBuf[buf], y1, lut);
+#endif
+    
+    for (y = y1; y <= y2; y++) {
+        // Start DMA sending this line...
+        DMA1_Channel3->CCR &= ~DMA_CCR_EN;
+        DMA1_Channel3->CMAR = (uint32_t)LineBuf[buf];
+        DMA1_Channel3->CNDTR = MAXX;
+        DMA1_Channel3->CCR |= DMA_CCR_EN;
+        
+        buf = !buf;
+        
+        // ...while we expand the next one
+        if (y < y2)
+#ifdef COLOUR_FRAME
+            expandLine(LineBuf[buf], y + 1);
+#else
+            expandLine(LineBuf[buf], y + 1, lut);
+#endif
+        
+        while ((DMA1->ISR & DMA_ISR_TCIF3) == 0)
+            ;
+        
+        DMA1->IFCR = DMA_IFCR_CTCIF3;
+    }
+    
+    // DMA has finished feeding SPI1, but the last word may still be shifting out
+    while ((SPI1->SR & SPI_SR_TXE) == 0)
+        ;
+    
+    while (SPI1->SR & SPI_SR_BSY)
+        ;
+    
+    // Nobody read the Rx data during the transfer, so clear RXNE and OVR
+    junk = SPI1->DR;
+    junk = SPI1->SR;
+    
     spi_cs(1);
     SPI1->CR1 &= ~SPI_CR1_DFF;    // Back to 8-bit mode
 }
@@ -437,6 +527,15 @@ void OLED_begin(const int wd, const int ht)
 
 void greyFrame(void)
 {
+#ifdef COLOUR_FRAME
+    int r;
+    
+    for (r = 0; r < MAXY; r += 2)
+    {
+        memset(Frame[r], 0x70, MAXX / 2);        // Black, white
+        memset(Frame[r + 1], 0x07, MAXX / 2);    // White, black
+    }
+#else
     int r, c;
 
     for (r = 0; r < MAXROWS; r++)
@@ -447,6 +546,122 @@ void greyFrame(void)
             Frame[r][c + 1] = 0x55;
         }
     }
+#endif
+}
+
+
+#ifdef COLOUR_FRAME
+/* buildPairLut --- make the table that expands bytes of 'Frame' into pairs of pixels */
+
+static void buildPairLut(void)
+{
+    int i;
+    
+    for (i = 0; i < 256; i++)
+        PairLut[i] = Palette[i & 0x0f] | ((uint32_t)Palette[i >> 4] << 16);
+}
+
+
+/* setPalette --- change the colour shown for one palette index */
+
+void setPalette(const int index, const uint16_t c)
+{
+    Palette[index & 0x0f] = c;
+    
+    buildPairLut();
+}
+
+
+/* colourPen --- return the palette index nearest to an RGB565 colour */
+
+static int colourPen(const uint16_t c)
+{
+    int i;
+    int best = 0;
+    long bestDist = 0x7fffffff;
+    
+    for (i = 0; i < 16; i++) {
+        const int d1 = ((Palette[i] >> 11) & 0x1f) - ((c >> 11) & 0x1f);
+        const int d2 = (((Palette[i] >> 5) & 0x3f) - ((c >> 5) & 0x3f)) / 2;
+        const int d3 = (Palette[i] & 0x1f) - (c & 0x1f);
+        const long dist = (d1 * d1) + (d2 * d2) + (d3 * d3);
+        
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = i;
+        }
+    }
+    
+    return (best);
+}
+
+
+/* putPixel --- store one palette index into the frame buffer */
+
+static void putPixel(const unsigned int x, const unsigned int y, const uint8_t p)
+{
+    uint8_t *b = &Frame[y][x / 2];
+    
+    if (x & 1)
+        *b = (*b & 0x0f) | (p << 4);
+    else
+        *b = (*b & 0xf0) | p;
+}
+
+
+/* fillSpan --- store one palette index into a horizontal run of pixels */
+
+static void fillSpan(int x1, int x2, const unsigned int y, const uint8_t p)
+{
+    // Odd pixels at either end share a byte with their neighbours;
+    // everything between is whole bytes
+    if (x1 & 1)
+        putPixel(x1++, y, p);
+    
+    if (((x2 & 1) == 0) && (x2 >= x1))
+        putPixel(x2--, y, p);
+    
+    if (x1 < x2)
+        memset(&Frame[y][x1 / 2], p * 0x11, ((x2 - x1) + 1) / 2);
+}
+#endif
+
+
+/* setInk --- choose the colour for subsequent drawing */
+
+void setInk(const uint16_t colour)
+{
+#ifdef COLOUR_FRAME
+    Pen = colourPen(colour);
+#else
+    // The whole 1bpp frame is shown in one colour, chosen by updscreen()
+#endif
+}
+
+
+/* renderPages --- copy a bitmap of 8-pixel-high pages into the frame buffer */
+
+void renderPages(const int x1, const int page1, const int wd, const int npages, const uint8_t *bitmap, const int stride)
+{
+    int i;
+    
+#ifdef COLOUR_FRAME
+    int x, j;
+    
+    for (i = 0; i < npages; i++) {
+        const uint8_t *src = bitmap + (i * stride);
+        
+        for (j = 0; j < 8; j++) {
+            const int y = ((page1 + i) * 8) + j;
+            
+            for (x = 0; x < wd; x++)
+                putPixel(x1 + x, y, ((src[x] >> j) & 1) ? Pen : 0);
+        }
+    }
+#else
+    for (i = 0; i < npages; i++)
+        memcpy(&Frame[page1 + i][x1], bitmap + (i * stride), wd);
+#endif
 }
 
 
@@ -455,7 +670,11 @@ void greyFrame(void)
 void setPixel(const unsigned int x, const unsigned int y)
 {
     if ((x < MAXX) && (y < MAXY))
+#ifdef COLOUR_FRAME
+        putPixel(x, y, Pen);
+#else
         Frame[y / 8][x] |= 1 << (y & 7);
+#endif
     else
     {
 //      Serial.print("setPixel(");
@@ -472,7 +691,11 @@ void setPixel(const unsigned int x, const unsigned int y)
 void clrPixel(const unsigned int x, const unsigned int y)
 {
     if ((x < MAXX) && (y < MAXY))
+#ifdef COLOUR_FRAME
+        putPixel(x, y, 0);
+#else
         Frame[y / 8][x] &= ~(1 << (y & 7));
+#endif
     else
     {
 //      Serial.print("clrPixel(");
@@ -510,12 +733,16 @@ void clrVline(const unsigned int x, const unsigned int y1, const unsigned int y2
 
 void setHline(const unsigned int x1, const unsigned int x2, const unsigned int y)
 {
+#ifdef COLOUR_FRAME
+    fillSpan(x1, x2, y, Pen);
+#else
     unsigned int x;
     const unsigned int row = y / 8;
     const uint8_t b = 1 << (y  & 7);
 
     for (x = x1; x <= x2; x++)
         Frame[row][x] |= b;
+#endif
 }
 
 
@@ -523,12 +750,16 @@ void setHline(const unsigned int x1, const unsigned int x2, const unsigned int y
 
 void clrHline(const unsigned int x1, const unsigned int x2, const unsigned int y)
 {
+#ifdef COLOUR_FRAME
+    fillSpan(x1, x2, y, 0);
+#else
     unsigned int x;
     const unsigned int row = y / 8;
     const uint8_t b = ~(1 << (y  & 7));
 
     for (x = x1; x <= x2; x++)
       Frame[row][x] &= b;
+#endif
 }
 
 
@@ -901,10 +1132,7 @@ void drawSegCN(const int x, const int style)
 void renderHexDigit(const int x, const int digit, const int style)
 {
    if (style == PETROL_STATION_STYLE) {
-      int i;
-      
-      for (i = 0; i < DIGIT_ROWS; i++)
-         memcpy(&Frame[i][x], &PetrolDigits[i][digit * DIGIT_WIDTH], DIGIT_WIDTH);
+      renderPages(x, 0, DIGIT_WIDTH, DIGIT_ROWS, &PetrolDigits[0][digit * DIGIT_WIDTH], sizeof (PetrolDigits[0]));
    }
    else {
       switch (digit) {
@@ -1279,6 +1507,24 @@ static void initSPI(void)
 }
 
 
+/* initDMA --- set up DMA for SPI1 Tx */
+
+static void initDMA(void)
+{
+   // Configure Reset and Clock Control
+   RCC->AHBENR |= RCC_AHBENR_DMA1EN;                      // Enable clock to DMA1 controller on AHB bus
+   
+   // Set up DMA1 Channel 3, which is SPI1_TX
+   DMA1_Channel3->CCR = 0;
+   DMA1_Channel3->CCR |= DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0;  // 16-bit memory and peripheral
+   DMA1_Channel3->CCR |= DMA_CCR_MINC;                    // Increment memory address only
+   DMA1_Channel3->CCR |= DMA_CCR_DIR;                     // Memory-to-peripheral
+   DMA1_Channel3->CPAR = (uint32_t)&SPI1->DR;
+   
+   SPI1->CR2 |= SPI_CR2_TXDMAEN;                          // Let SPI1 make DMA requests on Tx empty
+}
+
+
 /* initMillisecondTimer --- set up a timer to interrupt every millisecond */
 
 static void initMillisecondTimer(void)
@@ -1309,6 +1555,7 @@ int main(void)
    initGPIOs();
    initUARTs();
    initSPI();
+   initDMA();
    initTimers();
    initMillisecondTimer();
    
@@ -1316,6 +1563,11 @@ int main(void)
    
    OLED_begin(MAXX, MAXY);
    
+#ifdef COLOUR_FRAME
+   buildPairLut();
+#endif
+   
+   setInk(colour);
    greyFrame();
     
    updscreen(0, MAXY - 1, SSD1351_WHITE);
@@ -1339,7 +1591,7 @@ int main(void)
             
             flag = !flag;
             
-            printf("millis() = %ld\n", millis());
+            printf("millis() = %lu\n", (unsigned long)millis());
          }
          
          if ((displayMode == AUTO_HMS_MODE) && (millis() >= colon)) {
@@ -1540,12 +1792,15 @@ int main(void)
                break;
             case 'o':
             case 'O':
-               memcpy(&Frame[4][0], OLEDImage, sizeof (Frame) / 4);
+               setInk(SSD1351_BLUE);
+               renderPages(0, 4, MAXX, 4, &OLEDImage[0][0], sizeof (OLEDImage[0]));
+               setInk(colour);
                updscreen(32, 63, SSD1351_BLUE);
                break;
             case '\r':
-               for (hour = 0; hour < DIGIT_ROWS; hour++)
-                  memcpy(&Frame[hour + 8][0], &PetrolDigits[hour][0], DIGIT_WIDTH * 6);
+               setInk(SSD1351_GREEN);
+               renderPages(0, 8, DIGIT_WIDTH * 6, DIGIT_ROWS, &PetrolDigits[0][0], sizeof (PetrolDigits[0]));
+               setInk(colour);
                
                updscreen(64, 95, SSD1351_GREEN);
                break;
@@ -1580,6 +1835,7 @@ int main(void)
             case 'N':
                style = PETROL_STATION_STYLE;
                colour = PETROL_STATION_COLOUR;
+               setInk(colour);
                break;
             case 'u':
             case 'U':
@@ -1589,21 +1845,25 @@ int main(void)
             case 'V':
                style = VFD_STYLE;
                colour = VFD_COLOUR;
+               setInk(colour);
                break;
             case 'w':
             case 'W':
                style = LED_DOT_STYLE;
                colour = LED_COLOUR;
+               setInk(colour);
                break;
             case 'x':
             case 'X':
                style = PANAPLEX_STYLE;
                colour = PANAPLEX_COLOUR;
+               setInk(colour);
                break;
             case 'y':
             case 'Y':
                style = LED_BAR_STYLE;
                colour = LED_COLOUR;
+               setInk(colour);
                break;
             case 'z':
             case 'Z':
@@ -7,11 +7,11 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 #include <ctype.h>
 
 #include "arrows.h"
 #include "font.h"
+#include "trig.h"
 
 #define ADC_RANGE    (4096)            // Range of 12-bit ADC (0-4095)
 #define ADC_CENTRE   (ADC_RANGE / 2)   // Middle of range
@@ -31,19 +31,87 @@
 #define SCANNER_RADIUS      (60)  // Radius of scanner display -- could increase with a power-up?
 #define SCANNER_INC_DEGREES (3)   // Increment of scanner angle for each scan
 
+#ifndef NTARGETS
 #define NTARGETS  10    // Number of randomly-placed radar targets on playfield
+#endif
+
 #define NECHOES   10    // Maximum number of echoes displayed
 
+#define NO_ECHO  (-1)   // End of a list of echoes
+
+#if (NECHOES < 1) || (NECHOES > INT16_MAX)
+#error NECHOES must be from 1 to INT16_MAX
+#endif
+
+#define ECHO_DEGREES  (6)    // Targets less than this many degrees from the beam make echoes
+
+#define MAX_RADIUS  (255)   // Largest circle we can draw
+
+#define SWEEP_DEGREES  (4)  // Width of the bright radar beam
+#define TRAIL_DEGREES  (SCANNER_INC_DEGREES)  // Width of each dimmer step of the trail behind it
+
+#define SWEEP_STEPS  (360 / SCANNER_INC_DEGREES)  // Number of scanner angles in one revolution
+#define SWEEP_SPANS  (SWEEP_STEPS * (SCANNER_RADIUS + 2))  // Room for a trail and a beam slice for each angle in half a revolution
+
 #define DEFGAMEDURATION  (40)  // Number of radar scanner sweeps allowed
 #define MAXGAMEDURATION  (60)  // Maximum number of sweeps via power-up targets
 
 #define TIMERX  (MAXX - 9)
 #define TIMERY   4
 
+//#define INDEXED_FRAME     // 8-bit palette indices in the frame buffers, halving their size
+//#define SHADOW_FRAME      // Keep a copy of what's on the OLED and only send changes
+#define SPAN_MERGE_GAP (4)  // Unchanged pixels cheaper to resend than a new window
+//#define BAND_FRAME        // Record drawing and replay it into a band of rows, instead of a whole frame
+#define BAND_ROWS  (16)     // Height of the band in BAND_FRAME mode
+#define DL_SIZE    (160)    // Maximum number of drawing operations per frame in BAND_FRAME mode
+#ifdef BAND_FRAME
+#ifdef SHADOW_FRAME
+#error BAND_FRAME keeps no copy of the whole screen, so cannot be used with SHADOW_FRAME
+#endif
+#if (MAXY % BAND_ROWS) != 0
+#error MAXY must be a multiple of BAND_ROWS
+#endif
+#define FRAME_ROWS (BAND_ROWS)
+#else
+#define FRAME_ROWS (MAXY)
+#endif
+
+#ifndef BEARING_BUCKETS
+#define BEARING_BUCKETS  (SWEEP_STEPS)  // Targets are indexed by bearing, one bucket per scanner angle
+#endif
+
+#define BUCKET_WIDTH  ((360 * DEG_SCALE) / BEARING_BUCKETS)  // Width of a bucket in bearing units
+
+#if (BEARING_BUCKETS < 1) || (BEARING_BUCKETS > INT16_MAX) || (((360 * DEG_SCALE) % BEARING_BUCKETS) != 0)
+#error BEARING_BUCKETS must divide 360 * DEG_SCALE and fit in 16 bits
+#endif
+
+#define NO_TARGET  (-1)   // End of a list of targets
+#define NO_BUCKET  (-1)   // Target isn't in a bearing bucket
+
+#if (180 % SCANNER_INC_DEGREES) != 0
+#error SCANNER_INC_DEGREES must divide 180, so that the sweep table can be turned through half a revolution
+#endif
+
 #define MAXPLAYX (MAXX * 2)
 #define MAXPLAYY (MAXY * 2)
 
-#define RADTODEG  57.29578
+#if (MAXPLAYX > INT16_MAX) || (MAXPLAYY > INT16_MAX)
+#error Target co-ordinates are 16 bits, so the playfield must be smaller than 32768 pixels
+#endif
+
+#if SCANNER_RADIUS > 255
+#error Target ranges are kept squared in 16 bits, so SCANNER_RADIUS must be 255 or less
+#endif
+
+#ifndef CELL_SHIFT
+#define CELL_SHIFT  (5)   // Grid cells for finding nearby targets are 32x32 pixels
+#endif
+
+#define GRID_COLS   ((MAXPLAYX >> CELL_SHIFT) + 1)
+#define GRID_ROWS   ((MAXPLAYY >> CELL_SHIFT) + 1)
+
 
 enum cardinalDirections {
    NORTH = 1,
@@ -129,6 +197,52 @@ struct UART_BUFFER
     struct UART_RX_BUFFER rx;
 };
 
+// One pixel in the frame buffer
+#ifdef INDEXED_FRAME
+typedef uint8_t pixel_t;
+#else
+typedef uint16_t pixel_t;
+#endif
+
+// A word of pixels, for filling the frame buffer 32 bits at a time
+typedef uint32_t __attribute__((may_alias)) pixword_t;
+
+// A rectangle that drawing is clipped to
+struct clip_t {
+   int x1, y1;
+   int x2, y2;
+};
+
+// A straight edge being stepped down the rows, one division-free step per row
+struct edge_t {
+   int q, rem;          // Limit on x for this row, as a whole part and remainder
+   int dq, drem;        // Change from one row to the next
+   int den;             // Denominator, or zero for a horizontal edge
+   int c;
+   bool upper;          // Limit is an upper one, rather than lower
+};
+
+// A pie slice being stepped down the rows, one span per row
+struct sector_t {
+   int r2;              // Radius squared
+   int w;               // Half-width of the circle on this row
+   int y;
+   struct edge_t edge1, edge2;
+};
+
+// Cohen-Sutherland outcodes, for where a point lies relative to the clip rectangle
+#define OUT_LEFT   (1)
+#define OUT_RIGHT  (2)
+#define OUT_ABOVE  (4)
+#define OUT_BELOW  (8)
+
+// Ways of combining a colour with what's already in the frame buffer
+enum BLEND_OP {
+   BLEND_ALPHA,      // Mix by alpha, 0 (none of the new colour) to 32 (all of it)
+   BLEND_ADD,        // Add each component, saturating, for glows
+   BLEND_MULTIPLY    // Multiply each component, for tinting and shadows
+};
+
 
 // UART buffers
 struct UART_BUFFER U1Buf;
@@ -139,24 +253,56 @@ struct echo_t {
    unsigned int y;
    int age;
    int rad;
+   int16_t next;        // Next echo on the live list or the free list
 };
 
 struct echo_t Echo[NECHOES];
 
-// The targets
-struct target_t {
-   unsigned int x;
-   unsigned int y;
-   float bearing;
-   float range;
-   unsigned char siz;
-   int active:1;
-   int rings:1;
-   int axes:1;
-   int time:1;
+// Every echo lasts the same time, so the live list is kept in order of
+// age by adding new echoes at the tail
+int16_t EchoFree = NO_ECHO;    // Unused echoes
+int16_t EchoHead = NO_ECHO;    // Live echoes, oldest first
+int16_t EchoTail = NO_ECHO;
+
+// Big enough to number all the targets
+#if NTARGETS > INT16_MAX
+typedef int32_t tindex_t;
+#else
+typedef int16_t tindex_t;
+#endif
+
+// Target flags
+#define TARGET_ACTIVE  (1 << 0)   // Not yet picked up
+#define TARGET_RINGS   (1 << 1)   // Picking it up turns on the range rings
+#define TARGET_AXES    (1 << 2)   // Picking it up turns on the axes
+#define TARGET_TIME    (1 << 3)   // Picking it up gives more time, once
+
+// The targets, with an array for each field so that the loops over
+// them only touch the fields they need
+struct targets_t {
+   int16_t x[NTARGETS];
+   int16_t y[NTARGETS];
+   uint16_t bearing[NTARGETS];      // In 1/DEG_SCALE degrees
+   uint16_t range2[NTARGETS];       // Range squared
+   uint8_t siz[NTARGETS];
+   uint8_t flags[NTARGETS];
+   tindex_t next[NTARGETS];         // Neighbours in the same bearing bucket
+   tindex_t prev[NTARGETS];
+   int16_t bucket[NTARGETS];        // Bearing bucket, or NO_BUCKET
+   tindex_t cellNext[NTARGETS];     // Next target in the same grid cell
 };
 
-struct target_t Target[NTARGETS];
+struct targets_t Target;
+
+// Active targets within range of the player indexed by bearing, so
+// that each step of the sweep only has to look at those near the beam
+tindex_t BearingBucket[BEARING_BUCKETS];
+
+// All the targets indexed by position on the playfield, so that when
+// the player moves we only have to look at those nearby
+tindex_t Grid[GRID_ROWS][GRID_COLS];
+
+int BonusCheck = -1;    // Pickup range bonuses were last checked at, or -1 after the player moves
 
 struct coord_t {
    unsigned int x;
@@ -164,9 +310,22 @@ struct coord_t {
 };
 
 struct coord_t Player;
+struct coord_t Bucketed;   // Player position when the bearing buckets were last updated
 
 int Gather_y = 3;
 
+// The radar sweep slices for the first half-revolution, as spans
+// relative to the centre of the scanner
+struct sweep_t {
+   int16_t first;       // Index of its top row in SweepSpan[]
+   int8_t ylo;          // Top row, relative to the centre
+   uint8_t rows;
+};
+
+struct sweep_t Sweep[SWEEP_STEPS / 2][2];   // Trail slice, then beam slice
+int8_t SweepSpan[SWEEP_SPANS][2];           // Left and right ends of each row
+int SweepRadius = -1;                       // Radius the table was built for
+
 unsigned int GameDuration = DEFGAMEDURATION;
 
 // Some attributes to "pick up" which are enhancements to the rather
@@ -175,8 +334,83 @@ unsigned int GameDuration = DEFGAMEDURATION;
 bool Rings = false;
 bool Axes = false;
 
-// The colour frame buffer, 32k bytes
-uint16_t Frame[MAXY][MAXX];
+#ifdef INDEXED_FRAME
+// The frame buffer of palette indices, 16k bytes (2k in BAND_FRAME mode)
+pixel_t Frame[FRAME_ROWS][MAXX];
+
+// RGB565 colour sent to the OLED for each palette index
+uint16_t Palette[256];
+
+// Set when the palette changes, so that every pixel must be resent
+bool PaletteChanged = false;
+#else
+// The colour frame buffer, 32k bytes (4k in BAND_FRAME mode)
+pixel_t Frame[FRAME_ROWS][MAXX];
+#endif
+
+#ifdef BAND_FRAME
+// Drawing operations recorded in the display list
+enum DL_OP {
+   DL_PIXEL,
+   DL_HLINE,
+   DL_VLINE,
+   DL_LINE,
+   DL_FILLRECT,
+   DL_CIRCLE,
+   DL_RING,          // Circle with no fill
+   DL_SPLITCIRCLE,
+   DL_SPLITRING,
+   DL_SECTOR,
+   DL_SWEEP,
+   DL_ROUNDRECT,
+   DL_TEXT,
+   DL_BITMAP,
+   DL_GREYFRAME,
+   DL_BACKGROUND,
+   DL_BLENDRECT,
+   DL_CLIP
+};
+
+// One recorded call to a drawing primitive
+struct DL_CMD {
+   uint8_t op;
+   int16_t ylo, yhi;       // Rows touched, so that bands can skip it
+   int16_t a, b, c, d, e;  // Co-ordinates and sizes, as passed to the primitive
+   uint16_t c1, c2;        // Colours
+   const void *p;          // Bitmap or text, which must stay put until the frame is sent
+};
+
+// The display list for the frame being drawn
+struct DL_CMD DisplayList[DL_SIZE];
+int DlLen = 0;
+bool DlOverflow = false;
+
+// Primitives are recorded, except while the list is being replayed
+bool DlRecording = true;
+
+// Screen row held in Frame[0]
+int FrameTop = 0;
+
+// Clip rectangle in force when the display list was started
+struct clip_t DlClip = {0, 0, MAXX - 1, MAXY - 1};
+#endif
+
+// Drawing is clipped to this rectangle, which is inclusive
+struct clip_t Clip = {0, 0, MAXX - 1, MAXY - 1};
+
+// The part of the clip rectangle that the frame buffer holds
+struct clip_t FrameClip = {0, 0, MAXX - 1, MAXY - 1};
+
+#ifdef SHADOW_FRAME
+// What we last sent to the OLED, the same size again
+pixel_t Shadow[MAXY][MAXX];
+#endif
+
+// Row offset of the edge at each step of Michener's circle algorithm
+uint8_t CircleY[MAX_RADIUS + 1];
+
+// Number of bytes sent on the SPI bus, reset at the start of each frame
+uint32_t BytesSent = 0;
 
 uint16_t TargetColr[7] = {
    16 << 5,                   // 0
@@ -340,6 +574,8 @@ static void spi_dc(const int dc)
 
 static uint8_t spi_txd(const uint8_t data)
 {
+   BytesSent++;
+   
    SPI1->DR = data;
    
    while ((SPI1->SR & SPI_SR_TXE) == 0)
@@ -407,14 +643,94 @@ static void oledCmd3b(const uint8_t c, const uint8_t b1, const uint8_t b2, const
 
 
 
-/* updscreen --- update the physical screen from the buffer */
+/* rowAddr --- return the frame buffer row for a screen row that the buffer is known to hold */
+
+static inline pixel_t *rowAddr(const int y)
+{
+#ifdef BAND_FRAME
+    return (Frame[y - FrameTop]);
+#else
+    return (Frame[y]);
+#endif
+}
+
+
+/* frameRow --- return the frame buffer row for a screen row, or NULL if the buffer doesn't hold it */
+
+static pixel_t *frameRow(const int y)
+{
+#ifdef BAND_FRAME
+    const int row = y - FrameTop;
+    
+    if ((row < 0) || (row >= BAND_ROWS))
+        return (NULL);
+#endif
+
+    return (rowAddr(y));
+}
+
+
+/* frameClip --- work out which part of the clip rectangle the frame buffer holds */
+
+static void frameClip(void)
+{
+    FrameClip = Clip;
+    
+#ifdef BAND_FRAME
+    if (FrameClip.y1 < FrameTop)
+        FrameClip.y1 = FrameTop;
+    
+    if (FrameClip.y2 > (FrameTop + BAND_ROWS - 1))
+        FrameClip.y2 = FrameTop + BAND_ROWS - 1;
+#endif
+}
+
+
+/* inClip --- return true if a pixel is inside the clip rectangle and the frame buffer */
+
+static inline bool inClip(const int x, const int y)
+{
+    return ((x >= FrameClip.x1) && (x <= FrameClip.x2) && (y >= FrameClip.y1) && (y <= FrameClip.y2));
+}
+
 
-static void __attribute__((optimize("O3"))) updscreen(const uint8_t y1, const uint8_t y2)
+/* outcode --- return the Cohen-Sutherland outcode of a point */
+
+static int outcode(const int x, const int y)
+{
+    int code = 0;
+    
+    if (x < FrameClip.x1)
+        code |= OUT_LEFT;
+    else if (x > FrameClip.x2)
+        code |= OUT_RIGHT;
+    
+    if (y < FrameClip.y1)
+        code |= OUT_ABOVE;
+    else if (y > FrameClip.y2)
+        code |= OUT_BELOW;
+    
+    return (code);
+}
+
+
+/* putPixel --- store one pixel into the frame buffer, if it's inside the clip rectangle */
+
+static void putPixel(const int x, const int y, const pixel_t p)
+{
+    if (inClip(x, y))
+        rowAddr(y)[x] = p;
+}
+
+
+/* updwindow --- update a window of the physical screen from the buffer */
+
+static void __attribute__((optimize("O3"))) updwindow(const uint8_t x1, const uint8_t y1, const uint8_t x2, const uint8_t y2)
 {
     int x, y;
     volatile uint16_t __attribute__((unused)) junk;
     
-    oledCmd2b(SSD1351_SETCOLUMN, 0, MAXX - 1);
+    oledCmd2b(SSD1351_SETCOLUMN, x1, x2);
     oledCmd2b(SSD1351_SETROW, y1, y2);
     
     oledCmd(SSD1351_WRITERAM);
@@ -422,9 +738,15 @@ static void __attribute__((optimize("O3"))) updscreen(const uint8_t y1, const ui
     SPI1->CR1 |= SPI_CR1_DFF;    // 16-bit mode for just a bit more speed
     spi_cs(0);
     
-    for (y = y1; y <= y2; y++)
-        for (x = 0; x < MAXX; x++) {
-            SPI1->DR = Frame[y][x];
+    for (y = y1; y <= y2; y++) {
+        const pixel_t *const row = frameRow(y);
+        
+        for (x = x1; x <= x2; x++) {
+#ifdef INDEXED_FRAME
+            SPI1->DR = Palette[row[x]];
+#else
+            SPI1->DR = row[x];
+#endif
    
             while ((SPI1->SR & SPI_SR_TXE) == 0)
                ;
@@ -434,10 +756,89 @@ static void __attribute__((optimize("O3"))) updscreen(const uint8_t y1, const ui
       
             junk = SPI1->DR;
         }
+        
+#ifdef SHADOW_FRAME
+        memcpy(&Shadow[y][x1], &Frame[y][x1], ((x2 - x1) + 1) * sizeof (Frame[0][0]));
+#endif
+    }
      
     spi_cs(1);
     SPI1->CR1 &= ~SPI_CR1_DFF;    // Back to 8-bit mode
+    
+    BytesSent += ((x2 - x1) + 1) * ((y2 - y1) + 1) * sizeof (uint16_t);
+}
+
+
+#ifndef BAND_FRAME
+/* updscreen --- update the physical screen from the buffer */
+
+static void updscreen(const uint8_t y1, const uint8_t y2)
+{
+    updwindow(0, y1, MAXX - 1, y2);
+}
+
+
+/* updscreenDiff --- update only those parts of the physical screen that have changed */
+
+static void updscreenDiff(void)
+{
+#ifdef SHADOW_FRAME
+    // Compare each row with what we last sent and send each changed span
+    // as its own window. Spans separated by only a few unchanged pixels
+    // are merged, because those pixels cost less than another set of
+    // window commands. Identical spans on consecutive rows are merged
+    // into a single taller window.
+    int x, y;
+    int x1, x2;
+    int px1 = -1, px2 = -1, py1 = -1, py2 = -1;  // Pending window, not yet sent
+    
+#ifdef INDEXED_FRAME
+    if (PaletteChanged) {    // Shadow holds indices, which no longer mean the same colours
+        PaletteChanged = false;
+        updscreen(0, MAXY - 1);
+        return;
+    }
+#endif
+    
+    for (y = 0; y < MAXY; y++) {
+        for (x = 0; x < MAXX; x++) {
+            if (Frame[y][x] == Shadow[y][x])
+                continue;
+            
+            x1 = x;
+            x2 = x;
+            
+            for (x++; x < MAXX; x++) {
+                if (Frame[y][x] != Shadow[y][x])
+                    x2 = x;
+                else if ((x - x2) > SPAN_MERGE_GAP)
+                    break;
+            }
+            
+            if ((x1 == px1) && (x2 == px2) && (y == (py2 + 1))) {
+                py2 = y;
+            }
+            else {
+                if (py1 >= 0)
+                    updwindow(px1, py1, px2, py2);
+                
+                px1 = x1;
+                px2 = x2;
+                py1 = y;
+                py2 = y;
+            }
+            
+            x = x2;
+        }
+    }
+    
+    if (py1 >= 0)
+        updwindow(px1, py1, px2, py2);
+#else
+    updscreen(0, MAXY - 1);
+#endif
 }
+#endif  // BAND_FRAME
 
 
 /* OLED_begin --- initialise the SSD1351 OLED */
@@ -473,12 +874,242 @@ void OLED_begin(const int wd, const int ht)
 }
 
 
+/* colourIndex --- return the frame buffer pixel value for an RGB565 colour */
+
+static pixel_t colourIndex(const uint16_t c)
+{
+#ifdef INDEXED_FRAME
+    // The default palette is 3/3/2 bits of each 5/6/5 colour field
+    return (((c >> 8) & 0xE0) | ((c >> 6) & 0x1C) | ((c >> 3) & 0x03));
+#else
+    return (c);
+#endif
+}
+
+
+/* fillPattern --- fill a run of pixels with two alternating values, a word at a time */
+
+static void __attribute__((optimize("O3"))) fillPattern(pixel_t *dst, int n, pixel_t p0, pixel_t p1)
+{
+    pixword_t *w;
+    uint32_t word;
+    pixel_t t;
+    
+    // Ragged start, one pixel at a time up to a word boundary
+    while ((n > 0) && (((uintptr_t)dst & 3) != 0)) {
+        *dst++ = p0;
+        n--;
+        t = p0;
+        p0 = p1;
+        p1 = t;
+    }
+    
+#ifdef INDEXED_FRAME
+    word = p0 | (p1 << 8);
+    word |= word << 16;
+#else
+    word = p0 | ((uint32_t)p1 << 16);
+#endif
+    
+    // Four words per loop, which GCC can make into multiple-register stores.
+    // A word holds an even number of pixels, so the pattern stays in step
+    w = (pixword_t *)dst;
+    
+    for ( ; n >= (int)(16 / sizeof (pixel_t)); n -= 16 / sizeof (pixel_t)) {
+        w[0] = word;
+        w[1] = word;
+        w[2] = word;
+        w[3] = word;
+        w += 4;
+    }
+    
+    for ( ; n >= (int)(4 / sizeof (pixel_t)); n -= 4 / sizeof (pixel_t))
+        *w++ = word;
+    
+    // Ragged end
+    for (dst = (pixel_t *)w; n > 0; n--) {
+        *dst++ = p0;
+        t = p0;
+        p0 = p1;
+        p1 = t;
+    }
+}
+
+
+// RGB565 colour maths, two pixels to a 32-bit word. The F411 has the
+// Cortex-M4 SIMD instructions; elsewhere we do the same thing in plain C
+#define RB_G_MASK (0x07E0F81F)    // Red and blue of the low pixel, green of the high one
+
+#ifdef __ARM_FEATURE_DSP
+#define uqadd16(a, b)      __UQADD16((a), (b))
+#define smulbb(a, b)       __SMULBB((a), (b))
+#define smultt(a, b)       __SMULTT((a), (b))
+#define pkhbt(a, b)        __PKHBT((a), (b), 16)
+#else
+/* uqadd16 --- add two pairs of unsigned 16-bit numbers, saturating */
+
+static inline uint32_t uqadd16(const uint32_t a, const uint32_t b)
+{
+    uint32_t lo = (a & 0xffff) + (b & 0xffff);
+    uint32_t hi = (a >> 16) + (b >> 16);
+    
+    if (lo > 0xffff)
+        lo = 0xffff;
+    
+    if (hi > 0xffff)
+        hi = 0xffff;
+    
+    return (lo | (hi << 16));
+}
+
+#define smulbb(a, b)       ((int32_t)(int16_t)(a) * (int16_t)(b))
+#define smultt(a, b)       ((int32_t)(int16_t)((a) >> 16) * (int16_t)((b) >> 16))
+#define pkhbt(a, b)        (((a) & 0xffff) | ((b) << 16))
+#endif
+
+
+/* swap565x2 --- exchange the two pixels in a word */
+
+static inline uint32_t swap565x2(const uint32_t w)
+{
+    return ((w >> 16) | (w << 16));
+}
+
+
+/* alpha565x2 --- mix two pairs of pixels by an alpha of 0 to 32 */
+
+static inline uint32_t alpha565x2(const uint32_t fg, const uint32_t bg, const uint32_t alpha)
+{
+    // Masking leaves room above each component for it to be multiplied
+    // by 32, so one multiply scales three components at once
+    const uint32_t lo = ((((fg & RB_G_MASK) * alpha) + ((bg & RB_G_MASK) * (32 - alpha))) >> 5) & RB_G_MASK;
+    const uint32_t hi = ((((swap565x2(fg) & RB_G_MASK) * alpha) + ((swap565x2(bg) & RB_G_MASK) * (32 - alpha))) >> 5) & RB_G_MASK;
+    
+    return (lo | swap565x2(hi));
+}
+
+
+/* add565x2 --- add two pairs of pixels, each component saturating at full brightness */
+
+static inline uint32_t add565x2(const uint32_t fg, const uint32_t bg)
+{
+    // Shift each component to the top of its halfword, so that the
+    // saturating add clamps it at all-ones
+    const uint32_t r = uqadd16(fg & 0xF800F800, bg & 0xF800F800);
+    const uint32_t g = uqadd16((fg << 5) & 0xFC00FC00, (bg << 5) & 0xFC00FC00);
+    const uint32_t b = uqadd16((fg << 11) & 0xF800F800, (bg << 11) & 0xF800F800);
+    
+    return ((r & 0xF800F800) | ((g & 0xFC00FC00) >> 5) | ((b & 0xF800F800) >> 11));
+}
+
+
+/* mul565x2 --- multiply two pairs of pixels, component by component */
+
+static inline uint32_t mul565x2(const uint32_t fg, const uint32_t bg)
+{
+    const uint32_t rf = (fg >> 11) & 0x001F001F;
+    const uint32_t rb = (bg >> 11) & 0x001F001F;
+    const uint32_t gf = (fg >> 5) & 0x003F003F;
+    const uint32_t gb = (bg >> 5) & 0x003F003F;
+    const uint32_t bf = fg & 0x001F001F;
+    const uint32_t bb = bg & 0x001F001F;
+    
+    // Rounding up makes full brightness in one colour leave the other unchanged
+    const uint32_t r = ((pkhbt(smulbb(rf, rb), smultt(rf, rb)) + 0x001F001F) >> 5) & 0x001F001F;
+    const uint32_t g = ((pkhbt(smulbb(gf, gb), smultt(gf, gb)) + 0x003F003F) >> 6) & 0x003F003F;
+    const uint32_t b = ((pkhbt(smulbb(bf, bb), smultt(bf, bb)) + 0x001F001F) >> 5) & 0x001F001F;
+    
+    return ((r << 11) | (g << 5) | b);
+}
+
+
+/* blend565x2 --- combine two pairs of pixels by one of the BLEND_OPs */
+
+static inline uint32_t blend565x2(const int op, const uint32_t fg, const uint32_t bg, const uint32_t alpha)
+{
+    switch (op) {
+    case BLEND_ADD:
+        return (add565x2(fg, bg));
+    case BLEND_MULTIPLY:
+        return (mul565x2(fg, bg));
+    default:
+        return (alpha565x2(fg, bg, alpha));
+    }
+}
+
+
+/* blendSpan --- combine a colour into a run of pixels, a word at a time */
+
+static void __attribute__((optimize("O3"))) blendSpan(pixel_t *dst, int n, const uint16_t c, const int op, const uint32_t alpha)
+{
+#ifdef INDEXED_FRAME
+    // No room for two pixels to a word here, so go via the palette one by one
+    for ( ; n > 0; n--, dst++)
+        *dst = colourIndex(blend565x2(op, c, Palette[*dst], alpha));
+#else
+    const uint32_t fg = c | ((uint32_t)c << 16);
+    pixword_t *w;
+    
+    if ((n > 0) && (((uintptr_t)dst & 3) != 0)) {
+        *dst = blend565x2(op, fg, *dst, alpha);
+        dst++;
+        n--;
+    }
+    
+    // GCC moves the test of 'op' outside this loop
+    for (w = (pixword_t *)dst; n >= 2; n -= 2, w++)
+        *w = blend565x2(op, fg, *w, alpha);
+    
+    if (n > 0) {
+        dst = (pixel_t *)w;
+        *dst = blend565x2(op, fg, *dst, alpha);
+    }
+#endif
+}
+
+
+#ifdef BAND_FRAME
+/* dlRecord --- add a drawing operation to the display list */
+
+static void dlRecord(const int op, const int ylo, const int yhi, const int a, const int b, const int c, const int d, const int e, const uint16_t c1, const uint16_t c2, const void *p)
+{
+    struct DL_CMD *cmd;
+    
+    if (DlLen >= DL_SIZE) {
+        DlOverflow = true;    // The operation is lost, which we report when the frame is sent
+        return;
+    }
+    
+    cmd = &DisplayList[DlLen++];
+    
+    cmd->op = op;
+    cmd->ylo = ylo;
+    cmd->yhi = yhi;
+    cmd->a = a;
+    cmd->b = b;
+    cmd->c = c;
+    cmd->d = d;
+    cmd->e = e;
+    cmd->c1 = c1;
+    cmd->c2 = c2;
+    cmd->p = p;
+}
+#endif
+
+
 /* drawPixel --- draw a single pixel */
 
-void drawPixel(const unsigned int x, const unsigned int y, const uint16_t c)
+void drawPixel(const int x, const int y, const uint16_t c)
 {
-    if ((x < MAXX) && (y < MAXY))
-        Frame[y][x] = c;
+#ifdef BAND_FRAME
+    if (DlRecording) {
+        dlRecord(DL_PIXEL, y, y, x, y, 0, 0, 0, c, 0, NULL);
+        return;
+    }
+#endif
+
+    if (inClip(x, y))
+        rowAddr(y)[x] = colourIndex(c);
     else
     {
 //      Serial.print("drawPixel(");
@@ -499,8 +1130,15 @@ void setText(const int x, const int y, const char *str)
    // on a black background.
    int row, col;
    int i, j;
-   const uint16_t fg = SSD1351_WHITE;
-   const uint16_t bg = SSD1351_BLACK;
+   const pixel_t fg = colourIndex(SSD1351_WHITE);
+   const pixel_t bg = colourIndex(SSD1351_BLACK);
+   
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord(DL_TEXT, y, y + FONT_NROWS - 1, x, y, 0, 0, 0, 0, 0, str);
+      return;
+   }
+#endif
    
    col = x;
 
@@ -513,9 +1151,9 @@ void setText(const int x, const int y, const char *str)
          
          for (j = 0; j < FONT_NROWS; j++) {
             if (bits & (1 << j))
-               Frame[row][col] = fg;
+               putPixel(col, row, fg);
             else
-               Frame[row][col] = bg;
+               putPixel(col, row, bg);
             
             row++;
          }
@@ -526,7 +1164,7 @@ void setText(const int x, const int y, const char *str)
       row = y;
       
       for (j = 0; j < FONT_NROWS; j++) {
-         Frame[row++][col] = bg;
+         putPixel(col, row++, bg);
       }
       
       col++;
@@ -534,101 +1172,181 @@ void setText(const int x, const int y, const char *str)
 }
 
 
-/* drawLine --- draw a line between any two absolute co-ords */
+/* hspan --- fill a horizontal run of pixels, clipped */
 
-void drawLine(int x1, int y1, int x2, int y2, const int c)
+static inline void hspan(const int x1, const int x2, const int y, const pixel_t p)
 {
-   // Bresenham's line drawing algorithm. Originally coded on the IBM PC
-   // with EGA card in 1986.
-   int d;
-   int i1, i2;
-   int x, y;
-   int xend, yend;
-   int yinc, xinc;
+   const int xa = (x1 < FrameClip.x1) ? FrameClip.x1 : x1;
+   const int xb = (x2 > FrameClip.x2) ? FrameClip.x2 : x2;
 
-   const int dx = abs(x2 - x1);
-   const int dy = abs(y2 - y1);
+   if ((y >= FrameClip.y1) && (y <= FrameClip.y2))
+      fillPattern(&rowAddr(y)[xa], (xb - xa) + 1, p, p);
+}
 
-   if (((y1 > y2) && (dx < dy)) || ((x1 > x2) && (dx > dy))) {
-      int temp;
-      
-      temp = y1;
-      y1 = y2;
-      y2 = temp;
 
-      temp = x1;
-      x1 = x2;
-      x2 = temp;
-   }
+/* shortSpan --- fill a horizontal run of pixels that's likely to be short, clipped */
 
-   if (dy > dx) {
-      d = (2 * dx) - dy;     /* Slope > 1 */
-      i1 = 2 * dx;
-      i2 = 2 * (dx - dy);
+static inline void shortSpan(const int x1, const int x2, const int y, const pixel_t p)
+{
+   // Runs of a pixel or two are too short to be worth a call to
+   // fillPattern(), so write those directly when they're unclipped
+   int x;
+   pixel_t *row;
 
-      if (y1 > y2) {
-         x = x2;
-         y = y2;
-         yend = y1;
-      }
-      else {
-         x = x1;
-         y = y1;
-         yend = y2;
-      }
+   if (((x2 - x1) < 8) && (x1 >= FrameClip.x1) && (x2 <= FrameClip.x2) && (y >= FrameClip.y1) && (y <= FrameClip.y2)) {
+      row = rowAddr(y);
 
-      if (x1 > x2)
-         xinc = -1;
-      else
-         xinc = 1;
+      for (x = x1; x <= x2; x++)
+         row[x] = p;
+   }
+   else
+      hspan(x1, x2, y, p);
+}
 
-      drawPixel(x, y, c);
 
-      while (y < yend) {
-         y++;    
-         if (d < 0)
-            d += i1;
-         else {
-            x += xinc;
-            d += i2;
-         }
+/* vspan --- fill a vertical run of pixels, clipped */
+
+static inline void vspan(const int x, const int y1, const int y2, const pixel_t p)
+{
+   int y;
+   const int ya = (y1 < FrameClip.y1) ? FrameClip.y1 : y1;
+   const int yb = (y2 > FrameClip.y2) ? FrameClip.y2 : y2;
+   pixel_t *dst;
+
+   if ((x < FrameClip.x1) || (x > FrameClip.x2) || (ya > yb))
+      return;
+
+   for (y = ya, dst = &rowAddr(ya)[x]; y <= yb; y++, dst += MAXX)
+      *dst = p;
+}
+
+
+/* drawLine --- draw a line between any two absolute co-ords */
+
+void drawLine(int x1, int y1, int x2, int y2, const int c)
+{
+   // Run-slice version of the Bresenham line that was originally coded
+   // on the IBM PC with EGA card in 1986. It lights the same pixels,
+   // but works out the length of each horizontal or vertical run and
+   // fills it in one go. At major-axis step 'i', the minor axis has
+   // moved by (2 * i * minor + major) / (2 * major), so the run at
+   // minor offset 'm' ends at step ((2 * m + 1) * major - 1) / (2 * minor)
+   int i, last, end, rem;
+   int major, minor;
+   int q, r;
+   int inc;
+   int code1, code2;
+   bool steep;
+   pixel_t *dst;
+   const pixel_t p = colourIndex(c);
+
+   const int dx = abs(x2 - x1);
+   const int dy = abs(y2 - y1);
+
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord(DL_LINE, (y1 < y2) ? y1 : y2, (y1 < y2) ? y2 : y1, x1, y1, x2, y2, 0, c, 0, NULL);
+      return;
+   }
+#endif
+
+   // Lines wholly off one side of the clip rectangle need not be drawn.
+   // Lines that cross an edge have each run clipped as it's filled, so
+   // they stay on exactly the same pixels
+   code1 = outcode(x1, y1);
+   code2 = outcode(x2, y2);
+
+   if ((code1 & code2) != 0)
+      return;
+
+   if (dy == 0) {
+      hspan((x1 < x2) ? x1 : x2, (x1 < x2) ? x2 : x1, y1, p);
+      return;
+   }
+
+   if (dx == 0) {
+      vspan(x1, (y1 < y2) ? y1 : y2, (y1 < y2) ? y2 : y1, p);
+      return;
+   }
+
+   steep = dy > dx;
+
+   // Draw from the low end of the major axis
+   if ((steep && (y1 > y2)) || (!steep && (x1 > x2))) {
+      int temp;
 
-         drawPixel(x, y, c);
+      temp = y1;
+      y1 = y2;
+      y2 = temp;
+
+      temp = x1;
+      x1 = x2;
+      x2 = temp;
+   }
+
+   if (steep) {
+      major = dy;
+      minor = dx;
+      inc = (x1 > x2) ? -1 : 1;
+   }
+   else {
+      major = dx;
+      minor = dy;
+      inc = (y1 > y2) ? -1 : 1;
+   }
+
+   // Each run ends 'q' or 'q + 1' steps after the last one, depending
+   // on the remainder
+   q = major / minor;
+   r = major % minor;
+   end = (major - 1) / (2 * minor);
+   rem = (major - 1) % (2 * minor);
+
+   // Most runs are only a pixel or two long, so on a line wholly
+   // inside we walk a pointer along them instead of calling hspan()
+   // or vspan() for each
+   if ((code1 | code2) == 0) {
+      const int step = steep ? MAXX : 1;
+      const int jump = steep ? inc : inc * MAXX;
+
+      dst = &rowAddr(y1)[x1];
+
+      for (i = 0; i <= major; dst += jump) {
+         last = (end < major) ? end : major;
+
+         for ( ; i <= last; i++, dst += step)
+            *dst = p;
+
+         end += q;
+         rem += 2 * r;
+
+         if (rem >= (2 * minor)) {
+            rem -= 2 * minor;
+            end++;
+         }
       }
+
+      return;
    }
-   else {          
-      d = (2 * dy) - dx;  /* Slope < 1 */
-      i1 = 2 * dy;
-      i2 = 2 * (dy - dx);
 
-      if (x1 > x2) {
-         x = x2;
-         y = y2;
-         xend = x1;
+   for (i = 0; i <= major; i = last + 1) {
+      last = (end < major) ? end : major;
+
+      if (steep) {
+         vspan(x1, y1 + i, y1 + last, p);
+         x1 += inc;
       }
       else {
-         x = x1;
-         y = y1;
-         xend = x2;
+         hspan(x1 + i, x1 + last, y1, p);
+         y1 += inc;
       }
 
-      if (y1 > y2)
-         yinc = -1;
-      else
-         yinc = 1;
-
-      drawPixel(x, y, c);
+      end += q;
+      rem += 2 * r;
 
-      while (x < xend) {
-         x++;
-         if (d < 0)
-            d += i1;
-         else {
-            y += yinc;
-            d += i2;
-         }
-
-         drawPixel(x, y, c);
+      if (rem >= (2 * minor)) {
+         rem -= 2 * minor;
+         end++;
       }
    }
 }
@@ -636,221 +1354,597 @@ void drawLine(int x1, int y1, int x2, int y2, const int c)
 
 /* drawVline --- draw vertical line */
 
-void drawVline(const unsigned int x, const unsigned int y1, const unsigned int y2, const uint16_t c)
+void drawVline(const int x, const int y1, const int y2, const uint16_t c)
 {
-   unsigned int y;
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord(DL_VLINE, y1, y2, x, y1, y2, 0, 0, c, 0, NULL);
+      return;
+   }
+#endif
 
-   for (y = y1; y <= y2; y++)
-      Frame[y][x] = c;
+   vspan(x, y1, y2, colourIndex(c));
 }
 
 
 /* drawHline --- draw pixels in a horizontal line */
 
-void drawHline(const unsigned int x1, const unsigned int x2, const unsigned int y, const uint16_t c)
+void drawHline(const int x1, const int x2, const int y, const uint16_t c)
 {
-   unsigned int x;
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord(DL_HLINE, y, y, x1, x2, y, 0, 0, c, 0, NULL);
+      return;
+   }
+#endif
 
-   for (x = x1; x <= x2; x++)
-      Frame[y][x] = c;
+   hspan(x1, x2, y, colourIndex(c));
 }
 
 
-/* cfill --- draw horizontal lines to fill a circle */
+/* circleEdges --- run Michener's algorithm, noting the edge's row offset at each step */
 
-static void cfill(const int x0, const int y0, const int x, const int y, const int c)
+static int circleEdges(const int r)
 {
-   drawHline(x0 - x, x0 + x, y0 + y, c);
-   drawHline(x0 - x, x0 + x, y0 - y, c);
-   drawHline(x0 - y, x0 + y, y0 + x, c);
-   drawHline(x0 - y, x0 + y, y0 - x, c);
+   // Michener's circle algorithm. Originally coded on the IBM PC
+   // with EGA card in 1986. Returns the number of steps
+   int x, y;
+   int d;
+
+   x = 0;
+   y = r;
+   d = 3 - (2 * r);
+
+   while (x < y) {
+      CircleY[x] = y;
+      if (d < 0) {
+         d += (4 * x) + 6;
+      }
+      else {
+         d += (4 * (x - y)) + 10;
+         y--;
+      }
+      x++;
+   }
+
+   if (x == y)
+      CircleY[x++] = y;
+
+   return (x);
+}
+
+
+/* arcRow --- draw one row of a circle, or of the ends of a split circle */
+
+static void arcRow(const int y, const int x0, const int x1, const int inner, const int outer, const pixel_t ep, const pixel_t fp, const bool fill)
+{
+   int x;
+   pixel_t *row;
+
+   if ((y < FrameClip.y1) || (y > FrameClip.y2))
+      return;
+
+   if ((x0 - inner) >= (x1 + inner)) {
+      hspan(x0 - outer, x1 + outer, y, ep);   // The two edges meet in the middle
+      return;
+   }
+
+   // Edge runs are mostly a pixel or two, too short to be worth a
+   // call to hspan() unless they need clipping
+   if (((x0 - outer) >= FrameClip.x1) && ((x1 + outer) <= FrameClip.x2)) {
+      row = rowAddr(y);
+
+      for (x = x0 - outer; x <= (x0 - inner); x++)
+         row[x] = ep;
+
+      if (fill)
+         fillPattern(&row[(x0 - inner) + 1], ((x1 - x0) + (2 * inner)) - 1, fp, fp);
+
+      for (x = x1 + inner; x <= (x1 + outer); x++)
+         row[x] = ep;
+   }
+   else {
+      hspan(x0 - outer, x0 - inner, y, ep);
+
+      if (fill)
+         hspan((x0 - inner) + 1, (x1 + inner) - 1, y, fp);
+
+      hspan(x1 + inner, x1 + outer, y, ep);
+   }
 }
 
 
-/* cpts4 --- draw four pixels to form the edge of a circle */
+/* arcRows --- draw a split circle with edge and fill colours, writing each pixel once */
 
-static void cpts4(const int x0, const int y0, const int x, const int y, const int c)
+static void arcRows(const int x0, const int y0, const int x1, const int y1, const int r, const int ec, const int fc, const bool flat)
 {
-   drawPixel(x0 + x, y0 + y, c);
+   // The circle is split horizontally between x0 and x1, and vertically
+   // between y0 and y1. Each row of it gets at most an edge span, a fill
+   // span and another edge span. If 'flat', the top and bottom rows are
+   // all edge, as on a rounded rectangle
+   int k, i, first;
+   int inner, outer;
+   int n;
+   const pixel_t ep = colourIndex(ec);
+   const pixel_t fp = colourIndex(fc);
+
+   if ((r < 0) || (r > MAX_RADIUS))
+      return;
+
+   n = circleEdges(r);
+
+   // Michener's steps plot eight points each, and the ones that fall on
+   // row offset 'k' always form an unbroken run along the row: the steps
+   // whose 'y' is 'k' plot near the top and bottom, and step 'k' plots
+   // at the left and right. The fill reaches out to the edge
+   for (k = r, i = 0; k >= 0; k--) {
+      for (first = i; (i < n) && (CircleY[i] == k); i++)
+         ;
+
+      inner = (i > first) ? first : MAX_RADIUS;
+      outer = (i > first) ? (i - 1) : 0;
 
-//  if (x != 0)
-   drawPixel(x0 - x, y0 + y, c);
+      if (k < n) {
+         if (CircleY[k] < inner)
+            inner = CircleY[k];
 
-//  if (y != 0)  
-   drawPixel(x0 + x, y0 - y, c);
+         if (CircleY[k] > outer)
+            outer = CircleY[k];
+      }
+
+      if (flat && (k == r)) {
+         hspan(x0 - outer, x1 + outer, y0 - k, ep);
+         hspan(x0 - outer, x1 + outer, y1 + k, ep);
+         continue;
+      }
+
+      arcRow(y0 - k, x0, x1, inner, outer, ep, fp, fc >= 0);
 
-//  if ((x != 0) && (y != 0))
-   drawPixel(x0 - x, y0 - y, c);
+      if ((k != 0) || (y0 != y1))
+         arcRow(y1 + k, x0, x1, inner, outer, ep, fp, fc >= 0);
+   }
 }
 
 
-/* cpts8 --- draw eight pixels to form the edge of a circle */
+/* circle --- draw a circle with edge and fill colours */
 
-static void cpts8(const int x0, const int y0, const int x, const int y, const int c)
+void circle(const int x0, const int y0, const int r, const int ec, const int fc)
 {
-  cpts4 (x0, y0, x, y, c);
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord((fc >= 0) ? DL_CIRCLE : DL_RING, y0 - r, y0 + r, x0, y0, r, 0, 0, ec, fc, NULL);
+      return;
+   }
+#endif
 
-// if (x != y)
-    cpts4 (x0, y0, y, x, c);
+   arcRows(x0, y0, x0, y0, r, ec, fc, false);
 }
 
 
-/* splitcfill --- draw horizontal lines to fill a circle */
+/* drawSplitCircle --- draw a split circle with edge and fill colours */
 
-static void splitcfill(const int x0, const int y0, const int x1, const int y1, const int x, const int y, const int c)
+void drawSplitCircle(const int x0, const int y0, const int x1, const int y1, const int r, const int ec, const int fc)
 {
-   drawHline(x0 - x, x1 + x, y1 + y, c);
-   drawHline(x0 - x, x1 + x, y0 - y, c);
-   drawHline(x0 - y, x1 + y, y1 + x, c);
-   drawHline(x0 - y, x1 + y, y0 - x, c);
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord((fc >= 0) ? DL_SPLITCIRCLE : DL_SPLITRING, y0 - r, y1 + r, x0, y0, x1, y1, r, ec, fc, NULL);
+      return;
+   }
+#endif
+
+   arcRows(x0, y0, x1, y1, r, ec, fc, false);
 }
 
 
-/* splitcpts4 --- draw four pixels to form the edge of a split circle */
+/* fillRoundRect --- fill a rounded rectangle */
 
-static void splitcpts4(const int x0, const int y0, const int x1, const int y1, const int x, const int y, const int c)
+void fillRoundRect(const int x0, const int y0, const int x1, const int y1, const int r, const uint16_t ec, const uint16_t fc)
 {
-   drawPixel(x1 + x, y1 + y, c);
+   int y;
+   const pixel_t ep = colourIndex(ec);
+   const pixel_t fp = colourIndex(fc);
 
-//  if (x != 0)
-   drawPixel(x0 - x, y1 + y, c);
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord(DL_ROUNDRECT, y0, y1, x0, y0, x1, y1, r, ec, fc, NULL);
+      return;
+   }
+#endif
 
-//  if (y != 0)  
-   drawPixel(x1 + x, y0 - y, c);
+   // Corners, with the straight top and bottom edges
+   arcRows(x0 + r, y0 + r, x1 - r, y1 - r, r, ec, fc, true);
 
-//  if ((x != 0) && (y != 0))
-   drawPixel(x0 - x, y0 - y, c);
+   // Straight sides
+   for (y = y0 + r + 1; y < (y1 - r); y++) {
+      hspan(x0, x0, y, ep);
+      hspan(x0 + 1, x1 - 1, y, fp);
+      hspan(x1, x1, y, ep);
+   }
 }
 
 
-/* splitcpts8 --- draw eight pixels to form the edge of a split circle */
+/* isin --- return the sine of an angle in degrees, scaled by SIN_SCALE */
 
-static void splitcpts8(const int x0, const int y0, const int x1, const int y1, const int x, const int y, const int c)
+static int isin(int deg)
 {
-   splitcpts4(x0, y0, x1, y1, x, y, c);
+   deg %= 360;
 
-// if (x != y)
-      splitcpts4(x0, y0, x1, y1, y, x, c);
+   if (deg < 0)
+      deg += 360;
+
+   if (deg <= 90)
+      return (SinQ15[deg]);
+   else if (deg <= 180)
+      return (SinQ15[180 - deg]);
+   else if (deg <= 270)
+      return (-SinQ15[deg - 180]);
+   else
+      return (-SinQ15[360 - deg]);
 }
 
 
-/* circle --- draw a circle with edge and fill colours */
+/* icos --- return the cosine of an angle in degrees, scaled by SIN_SCALE */
 
-void circle(const int x0, const int y0, const int r, const int ec, const int fc)
+static int icos(const int deg)
 {
-   // Michener's circle algorithm. Originally coded on the IBM PC
-   // with EGA card in 1986.
-   int x, y;
-   int d;
+   return (isin(deg + 90));
+}
 
-   x = 0;
-   y = r;
-   d = 3 - (2 * r);
 
-   if (fc >= 0) {
-      while (x < y) {
-         cfill(x0, y0, x, y, fc);
-         if (d < 0) {
-            d += (4 * x) + 6;
-         }
-         else {
-            d += (4 * (x - y)) + 10;
-            y--;
-         }
-         x++;
+/* isqrt --- return the integer square root, rounded down */
+
+static int isqrt(unsigned int n)
+{
+   unsigned int root = 0;
+   unsigned int bit = 1u << 30;
+
+   while (bit > n)
+      bit >>= 2;
+
+   while (bit != 0) {
+      if (n >= (root + bit)) {
+         n -= root + bit;
+         root = (root >> 1) + bit;
       }
+      else
+         root >>= 1;
 
-      if (x == y)
-         cfill(x0, y0, x, y, fc);
+      bit >>= 2;
    }
 
-   x = 0;
-   y = r;
-   d = 3 - (2 * r);
+   return (root);
+}
 
-   while (x < y) {
-      cpts8(x0, y0, x, y, ec);
-      if (d < 0) {
-         d += (4 * x) + 6;
-      }
-      else {
-         d += (4 * (x - y)) + 10;
-         y--;
-      }
-      x++;
+
+/* iatan2 --- return the bearing of the point (x, y), from 0 up to 360 degrees in units of 1/DEG_SCALE */
+
+static int iatan2(const int y, const int x)
+{
+   // Fold the point into the first octant, where the tangent is from
+   // zero to one, and look that up in AtanTab with linear interpolation
+   // between entries. The table entries are rounded to the nearest
+   // unit, so the result is within 0.02 degrees of the true bearing
+   const int frac = 15 - ATAN_BITS;
+   unsigned int ax = abs(x);
+   unsigned int ay = abs(y);
+   unsigned int t;
+   int i, a;
+   const bool steep = (ay > ax);
+
+   if (steep) {
+      t = ax;
+      ax = ay;
+      ay = t;
    }
 
-   if (x == y)
-      cpts8(x0, y0, x, y, ec);
+   if (ax == 0)
+      return (0);
+
+   while (ax >= (1u << 16)) {          // Keep the tangent within 32 bits
+      ax >>= 1;
+      ay >>= 1;
+   }
+
+   t = (ay << 15) / ax;                // Tangent, scaled by 2^15
+   i = t >> frac;
+   a = AtanTab[i];
+
+   if (t & ((1 << frac) - 1))
+      a += (((AtanTab[i + 1] - AtanTab[i]) * (int)(t & ((1 << frac) - 1))) + (1 << (frac - 1))) >> frac;
+
+   if (steep)
+      a = (90 * DEG_SCALE) - a;
+
+   if (x < 0)
+      a = (180 * DEG_SCALE) - a;
+
+   if ((y < 0) && (a != 0))
+      a = (360 * DEG_SCALE) - a;
+
+   return (a);
 }
 
 
-/* drawSplitCircle --- draw a split circle with edge and fill colours */
+/* floorDiv --- divide by a positive number, rounding towards minus infinity */
 
-void drawSplitCircle(const int x0, const int y0, const int x1, const int y1, const int r, const int ec, const int fc)
+static inline int floorDiv(const int n, const int d)
 {
-   // Michener's circle algorithm. Originally coded on the IBM PC
-   // with EGA card in 1986.
-   int x, y;
-   int d;
+   const int q = n / d;
 
-   x = 0;
-   y = r;
-   d = 3 - (2 * r);
+   return (((q * d) > n) ? (q - 1) : q);
+}
 
-   if (fc >= 0) {
-      while (x < y) {
-         splitcfill(x0, y0, x1, y1, x, y, fc);
-         if (d < 0) {
-            d += (4 * x) + 6;
-         }
-         else {
-            d += (4 * (x - y)) + 10;
-            y--;
-         }
-         x++;
+
+/* ceilDiv --- divide by a positive number, rounding towards plus infinity */
+
+static inline int ceilDiv(const int n, const int d)
+{
+   return (-floorDiv(-n, d));
+}
+
+
+/* edgeStart --- set up to step down the rows of a straight edge through the origin */
+
+static void edgeStart(struct edge_t *e, const int c, const int s, const int y)
+{
+   // Pixels on the inside satisfy c * y - s * x >= 0, which limits x
+   // to c * y / s. That's an upper limit if s is positive and a lower
+   // one if s is negative. We keep its whole part and remainder
+   e->c = c;
+   e->upper = (s > 0);
+   e->den = abs(s);
+   
+   if (e->den == 0)
+      return;
+   
+   e->q = floorDiv(c * y, e->den);
+   e->rem = (c * y) - (e->q * e->den);
+   e->dq = floorDiv(c, e->den);
+   e->drem = c - (e->dq * e->den);
+}
+
+
+/* edgeStep --- move an edge down by a row */
+
+static inline void edgeStep(struct edge_t *e)
+{
+   if (e->den != 0) {
+      e->q += e->dq;
+      e->rem += e->drem;
+      
+      if (e->rem >= e->den) {
+         e->rem -= e->den;
+         e->q++;
       }
+   }
+}
+
 
-      if (x == y)
-         splitcfill(x0, y0, x1, y1, x, y, fc);
+/* edgeClip --- narrow a span to the inside of an edge, returning false if none of the row is inside */
+
+static inline bool edgeClip(const struct edge_t *e, const int y, int *xlo, int *xhi)
+{
+   if (e->den == 0)                    // Horizontal edge: the whole row is in or out
+      return ((e->c * y) >= 0);
+   
+   if (e->upper) {
+      if (e->q < *xhi)
+         *xhi = e->q;
+   }
+   else {
+      if (-e->q > *xlo)                // Lower limit is c * y / s = -(c * y / |s|), rounded up
+         *xlo = -e->q;
    }
+   
+   return (true);
+}
 
-   x = 0;
-   y = r;
-   d = 3 - (2 * r);
 
-   while (x < y) {
-      splitcpts8(x0, y0, x1, y1, x, y, ec);
-      if (d < 0) {
-         d += (4 * x) + 6;
-      }
-      else {
-         d += (4 * (x - y)) + 10;
-         y--;
+/* sectorRows --- find the rows, relative to the centre, that a pie slice of up to 180 degrees can cover */
+
+static void sectorRows(const int r, const int a1, const int a2, int *const ylo, int *const yhi)
+{
+   // Only scan the rows between the centre and the two ends of the
+   // arc, unless the arc passes straight down or up. That keeps
+   // narrow slices cheap
+   const int e1 = (r * isin(a1)) >> 15;
+   const int e2 = (r * isin(a2)) >> 15;
+
+   *ylo = ((e1 < e2) ? e1 : e2) - 1;
+   *yhi = ((e1 > e2) ? e1 : e2) + 1;
+
+   if (*ylo > 0)
+      *ylo = 0;
+
+   if (*yhi < 0)
+      *yhi = 0;
+
+   if ((*yhi > r) || (floorDiv(a2 - 90, 360) >= ceilDiv(a1 - 90, 360)))
+      *yhi = r;
+
+   if ((*ylo < -r) || (floorDiv(a2 - 270, 360) >= ceilDiv(a1 - 270, 360)))
+      *ylo = -r;
+}
+
+
+/* sectorStart --- set up to step down the rows of a pie slice of up to 180 degrees, from row 'y' */
+
+static void sectorStart(struct sector_t *const sec, const int r, const int a1, const int a2, const int y)
+{
+   // The half-width of the circle changes by a little from row to row,
+   // and the edges by a fixed amount
+   sec->r2 = r * r;
+   sec->w = isqrt(sec->r2 - (y * y));
+   sec->y = y;
+   edgeStart(&sec->edge1, icos(a1), isin(a1), y);     // c1 * y - s1 * x >= 0
+   edgeStart(&sec->edge2, -icos(a2), -isin(a2), y);   // s2 * x - c2 * y >= 0
+}
+
+
+/* sectorSpan --- find the span of a pie slice on the current row and move down a row, returning false if it's empty */
+
+static inline bool sectorSpan(struct sector_t *const sec, int *const xlo, int *const xhi)
+{
+   const int y = sec->y++;
+   const int h2 = sec->r2 - (y * y);
+   bool in;
+
+   while ((sec->w * sec->w) > h2)
+      sec->w--;
+
+   while (((sec->w + 1) * (sec->w + 1)) <= h2)
+      sec->w++;
+
+   *xlo = -sec->w;
+   *xhi = sec->w;
+
+   in = edgeClip(&sec->edge1, y, xlo, xhi) && edgeClip(&sec->edge2, y, xlo, xhi) && (*xlo <= *xhi);
+
+   edgeStep(&sec->edge1);
+   edgeStep(&sec->edge2);
+
+   return (in);
+}
+
+
+/* fillSector --- fill a pie slice from angle 'a1' clockwise to 'a2', in degrees */
+
+void fillSector(const int x0, const int y0, const int r, const int a1, int a2, const uint16_t c)
+{
+   // Angles are measured like the radar bearings, so that 0 degrees
+   // is to the right and 90 is straight down. A pixel is in the slice
+   // if it's on or inside the circle, and not anticlockwise of the
+   // first edge or clockwise of the second. Each edge limits one end
+   // of the span on each row, so every row is a single span
+   int y, ylo, yhi;
+   int xlo, xhi;
+   struct sector_t sec;
+   const pixel_t p = colourIndex(c);
+
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord(DL_SECTOR, y0 - r, y0 + r, x0, y0, r, a1, a2, c, 0, NULL);
+      return;
+   }
+#endif
+
+   if ((r < 0) || (a2 <= a1))
+      return;
+
+   // Slices wider than a semicircle go in two halves
+   if ((a2 - a1) > 180) {
+      if ((a2 - a1) >= 360)
+         a2 = a1 + 360;
+
+      fillSector(x0, y0, r, a1 + 180, a2, c);
+      a2 = a1 + 180;
+   }
+
+   sectorRows(r, a1, a2, &ylo, &yhi);
+
+   if ((y0 + ylo) < FrameClip.y1)
+      ylo = FrameClip.y1 - y0;
+
+   if ((y0 + yhi) > FrameClip.y2)
+      yhi = FrameClip.y2 - y0;
+
+   if (ylo > yhi)
+      return;
+
+   sectorStart(&sec, r, a1, a2, ylo);
+
+   for (y = ylo; y <= yhi; y++)
+      if (sectorSpan(&sec, &xlo, &xhi))
+         shortSpan(x0 + xlo, x0 + xhi, y0 + y, p);
+}
+
+
+/* sweepSetup --- build the table of radar sweep slices for one radius */
+
+void sweepSetup(const int radius)
+{
+   // The beam and each step of its trail start on one of the scanner
+   // angles, so we can work out their spans once and then just copy
+   // them into the frame. Turning a slice through 180 degrees swaps
+   // both the rows and the ends of each span, so only the first half
+   // of the revolution needs to be stored
+   int k, i, n;
+   int y, ylo, yhi;
+   int xlo, xhi;
+   struct sector_t sec;
+
+   SweepRadius = -1;
+
+   if ((radius < 0) || (radius > INT8_MAX))
+      return;
+
+   for (k = 0, n = 0; k < (SWEEP_STEPS / 2); k++) {
+      for (i = 0; i < 2; i++) {
+         const int a1 = k * SCANNER_INC_DEGREES;
+         const int a2 = a1 + (i ? SWEEP_DEGREES : TRAIL_DEGREES);
+
+         sectorRows(radius, a1, a2, &ylo, &yhi);
+
+         if ((n + (yhi - ylo) + 1) > SWEEP_SPANS)
+            return;                    // No room; sweep gets drawn the slow way
+
+         Sweep[k][i].first = n;
+         Sweep[k][i].ylo = ylo;
+         Sweep[k][i].rows = (yhi - ylo) + 1;
+
+         sectorStart(&sec, radius, a1, a2, ylo);
+
+         for (y = ylo; y <= yhi; y++, n++) {
+            if (sectorSpan(&sec, &xlo, &xhi)) {
+               SweepSpan[n][0] = xlo;
+               SweepSpan[n][1] = xhi;
+            }
+            else {
+               SweepSpan[n][0] = 1;    // Empty row
+               SweepSpan[n][1] = 0;
+            }
+         }
       }
-      x++;
    }
 
-   if (x == y)
-      splitcpts8(x0, y0, x1, y1, x, y, ec);
+   SweepRadius = radius;
 }
 
 
-/* fillRoundRect --- fill a rounded rectangle */
+/* drawSweep --- draw one slice of the radar sweep from the table */
 
-void fillRoundRect(const int x0, const int y0, const int x1, const int y1, const int r, const uint16_t ec, const uint16_t fc)
+static void drawSweep(int step, const int beam, const uint16_t c)
 {
-   int y;
+   int i, y;
+   const pixel_t p = colourIndex(c);
+   const struct sweep_t *sw;
+   const int8_t (*span)[2];
+
+#ifdef BAND_FRAME
+   if (DlRecording) {
+      dlRecord(DL_SWEEP, CENY - SweepRadius, CENY + SweepRadius, step, beam, 0, 0, 0, c, 0, NULL);
+      return;
+   }
+#endif
+
+   step %= SWEEP_STEPS;
 
-   drawSplitCircle(x0 + r, y0 + r, x1 - r, y1 - r, r, ec, fc);
+   if (step < 0)
+      step += SWEEP_STEPS;
 
-   drawHline(x0 + r, x1 - r, y0, ec);
-   drawHline(x0 + r, x1 - r, y1, ec);
-   drawVline(x0, y0 + r, y1 - r, ec);
-   drawVline(x1, y0 + r, y1 - r, ec);
+   sw = &Sweep[step % (SWEEP_STEPS / 2)][beam];
+   span = &SweepSpan[sw->first];
 
-   for (y = y0 + r; y < (y1 - r); y++)
-      drawHline (x0 + 1, x1 - 1, y, fc);
+   if (step < (SWEEP_STEPS / 2)) {
+      for (i = 0, y = CENY + sw->ylo; i < sw->rows; i++, y++)
+         if (span[i][0] <= span[i][1])
+            shortSpan(CENX + span[i][0], CENX + span[i][1], y, p);
+   }
+   else {
+      for (i = 0, y = CENY - sw->ylo; i < sw->rows; i++, y--)
+         if (span[i][0] <= span[i][1])
+            shortSpan(CENX - span[i][1], CENX - span[i][0], y, p);
+   }
 }
 
 
@@ -867,25 +1961,97 @@ void textRoundRect(const char *const str, const int ec, const int fc, const int
 }
 
 
+#ifdef INDEXED_FRAME
+/* setPalette --- change the colour shown for one palette index */
+
+void setPalette(const uint8_t index, const uint16_t c)
+{
+    Palette[index] = c;
+    PaletteChanged = true;
+}
+
+
+/* setPaletteRange --- change the colours shown for a run of palette indices */
+
+void setPaletteRange(const uint8_t first, const int n, const uint16_t *colours)
+{
+    int i;
+    
+    for (i = 0; i < n; i++)
+        Palette[(first + i) & 0xFF] = colours[i];
+    
+    PaletteChanged = true;
+}
+
+
+/* initPalette --- set up the default palette to match colourIndex() */
+
+static void initPalette(void)
+{
+    int i;
+    
+    for (i = 0; i < 256; i++) {
+        const uint16_t hi = (i >> 5) & 0x07;
+        const uint16_t mid = (i >> 2) & 0x07;
+        const uint16_t lo = i & 0x03;
+        
+        // Replicate the top bits into the low bits so that 0 and full scale map exactly
+        Palette[i] = (((hi << 2) | (hi >> 1)) << 11) | (((mid << 3) | mid) << 5) | ((lo << 3) | (lo << 1) | (lo >> 1));
+    }
+}
+#endif
+
+
+/* setClip --- restrict drawing to a rectangle within the screen */
+
+void setClip(const int x1, const int y1, const int x2, const int y2)
+{
+#ifdef BAND_FRAME
+    // Recorded for every band, but the clip applies from now on as well
+    if (DlRecording)
+        dlRecord(DL_CLIP, 0, MAXY - 1, x1, y1, x2, y2, 0, 0, 0, NULL);
+#endif
+
+    Clip.x1 = (x1 < 0) ? 0 : x1;
+    Clip.y1 = (y1 < 0) ? 0 : y1;
+    Clip.x2 = (x2 > (MAXX - 1)) ? (MAXX - 1) : x2;
+    Clip.y2 = (y2 > (MAXY - 1)) ? (MAXY - 1) : y2;
+    
+    frameClip();
+}
+
+
+/* resetClip --- allow drawing anywhere on the screen */
+
+void resetClip(void)
+{
+    setClip(0, 0, MAXX - 1, MAXY - 1);
+}
+
+
 /* greyFrame --- clear entire frame to checkerboard pattern */
 
 void greyFrame(void)
 {
-    int r, c;
+    int r;
+    const pixel_t black = colourIndex(SSD1351_BLACK);
+    const pixel_t white = colourIndex(SSD1351_WHITE);
+
+#ifdef BAND_FRAME
+    if (DlRecording) {
+        dlRecord(DL_GREYFRAME, 0, MAXY - 1, 0, 0, 0, 0, 0, 0, 0, NULL);
+        return;
+    }
+#endif
 
-    for (r = 0; r < MAXY; r += 2)
+    for (r = 0; r < MAXY; r++)
     {
-        for (c = 0; c < MAXX; c += 2)
-        {
-            Frame[r][c] = SSD1351_BLACK;
-            Frame[r][c + 1] = SSD1351_WHITE;
-        }
+        pixel_t *const row = frameRow(r);
+        const pixel_t even = (r & 1) ? white : black;
+        const pixel_t odd = (r & 1) ? black : white;
         
-        for (c = 0; c < MAXX; c += 2)
-        {
-            Frame[r + 1][c] = SSD1351_WHITE;
-            Frame[r + 1][c + 1] = SSD1351_BLACK;
-        }
+        if (row != NULL)
+            fillPattern(row, MAXX, even, odd);
     }
 }
 
@@ -907,6 +2073,13 @@ void fillRect(const int x1, const int y1, const int x2, const int y2, const uint
 {
     int y;
 
+#ifdef BAND_FRAME
+    if (DlRecording) {
+        dlRecord(DL_FILLRECT, y1, y2, x1, y1, x2, y2, 0, ec, fc, NULL);
+        return;
+    }
+#endif
+
     for (y = y1; y <= y2; y++)
         drawHline(x1, x2, y, fc);
 
@@ -917,6 +2090,28 @@ void fillRect(const int x1, const int y1, const int x2, const int y2, const uint
 }
 
 
+/* blendRect --- combine a colour into a filled rectangle, for translucent overlays */
+
+void blendRect(const int x1, const int y1, const int x2, const int y2, const uint16_t c, const int op, const int alpha)
+{
+    int y;
+    const int xa = (x1 < FrameClip.x1) ? FrameClip.x1 : x1;
+    const int xb = (x2 > FrameClip.x2) ? FrameClip.x2 : x2;
+    const int ya = (y1 < FrameClip.y1) ? FrameClip.y1 : y1;
+    const int yb = (y2 > FrameClip.y2) ? FrameClip.y2 : y2;
+
+#ifdef BAND_FRAME
+    if (DlRecording) {
+        dlRecord(DL_BLENDRECT, y1, y2, x1, y1, x2, y2, alpha, c, op, NULL);
+        return;
+    }
+#endif
+
+    for (y = ya; y <= yb; y++)
+        blendSpan(&rowAddr(y)[xa], (xb - xa) + 1, c, op, alpha);
+}
+
+
 /* renderBitmap --- render pixels into the framebuffer according to a bitmap */
 
 void renderBitmap(const int x1, const int y1, const int wd, const int ht, const uint8_t *bitmap, const int stride, const uint16_t fg, const uint16_t bg)
@@ -926,58 +2121,228 @@ void renderBitmap(const int x1, const int y1, const int wd, const int ht, const
     const uint8_t *row;
     const int x2 = x1 + wd - 1;
     const int y2 = y1 + ht - 1;
+    const int xa = (x1 < FrameClip.x1) ? FrameClip.x1 : x1;
+    const int xb = (x2 > FrameClip.x2) ? FrameClip.x2 : x2;
+    const int ya = (y1 < FrameClip.y1) ? FrameClip.y1 : y1;
+    const int yb = (y2 > FrameClip.y2) ? FrameClip.y2 : y2;
+    const pixel_t fp = colourIndex(fg);
+    const pixel_t bp = colourIndex(bg);
+    pixel_t *dst;
     
-    for (y = y1, i = 0; y <= y2; y++, i++) {
+#ifdef BAND_FRAME
+    if (DlRecording) {
+        dlRecord(DL_BITMAP, y1, y2, x1, y1, wd, ht, stride, fg, bg, bitmap);
+        return;
+    }
+#endif
+    
+    for (y = ya, i = ya - y1; y <= yb; y++, i++) {
+        dst = rowAddr(y);
         row = bitmap + (stride * (i / 8));
         
-        for (x = x1, j = 0; x <= x2; x++, j++)
+        for (x = xa, j = xa - x1; x <= xb; x++, j++)
             if (row[j] & (1 << (i % 8)))
-                Frame[y][x] = fg;
+                dst[x] = fp;
             else
-                Frame[y][x] = bg;
+                dst[x] = bp;
     }
 }
 
 
-/* drawBackground --- draw the screen background */
+/* drawBackgroundAt --- draw the screen background for a given player position */
 
-void drawBackground(void)
+static void drawBackgroundAt(const int px, const int py)
 {
-   int x, y;
+   // Checkerboard background, the same pattern as greyFrame(), where
+   // the playing area is visible and black off its edges. The edges
+   // only move when the player does, so we keep them from one frame
+   // to the next. Each row is then filled once, as at most three runs.
+   // Like greyFrame(), this covers the whole frame whatever the clip
+   static int lastx = -1, lasty = -1;
+   static struct clip_t board;         // Part of the screen showing the playing area
+   int r;
+   int x1, x2;
+   const pixel_t black = colourIndex(SSD1351_BLACK);
+   const pixel_t white = colourIndex(SSD1351_WHITE);
+
+   if ((px != lastx) || (py != lasty)) {
+      board.x1 = (px < CENX) ? (CENX - px) + 1 : 0;
+      board.y1 = (py < CENY) ? (CENY - py) + 1 : 0;
+      board.x2 = ((MAXPLAYX - px) < CENX) ? ((MAXPLAYX - px) + CENX) - 1 : MAXX - 1;
+      board.y2 = ((MAXPLAYY - py) < CENY) ? ((MAXPLAYY - py) + CENY) - 1 : MAXY - 1;
+      lastx = px;
+      lasty = py;
+   }
 
-   // Checkerboard background
-   for (y = 0; y < MAXY; y++) {
-      for (x = 0; x < MAXX; x += 2) {
-         if (y & 1) {
-            drawPixel(x, y, SSD1351_WHITE);
-            drawPixel(x + 1, y, SSD1351_BLACK);
-         }
-         else {
-            drawPixel(x, y, SSD1351_BLACK);
-            drawPixel(x + 1, y, SSD1351_WHITE);
-         }  
-      }
+   // Usually there's no edge in sight
+   if ((board.x1 == 0) && (board.y1 == 0) && (board.x2 == (MAXX - 1)) && (board.y2 == (MAXY - 1))) {
+      greyFrame();
+      return;
    }
 
-   // Four cases where the edge of the playing area is visible
-   if (Player.x < CENX) {
-      fillRect(0, 0, CENX - Player.x, MAXY - 1, SSD1351_BLACK, SSD1351_BLACK);
+   x1 = board.x1;
+   x2 = board.x2;
+
+   for (r = 0; r < MAXY; r++) {
+      pixel_t *const row = frameRow(r);
+
+      if (row == NULL)
+         continue;
+
+      if ((r < board.y1) || (r > board.y2) || (x1 > x2)) {
+         fillPattern(row, MAXX, black, black);
+      }
+      else {
+         const pixel_t even = ((x1 + r) & 1) ? white : black;
+         const pixel_t odd = ((x1 + r) & 1) ? black : white;
+
+         if (x1 > 0)
+            fillPattern(row, x1, black, black);
+
+         fillPattern(&row[x1], (x2 - x1) + 1, even, odd);
+
+         if (x2 < (MAXX - 1))
+            fillPattern(&row[x2 + 1], (MAXX - 1) - x2, black, black);
+      }
    }
+}
+
 
-   if (Player.y < CENY) {
-      fillRect(0, 0, MAXX - 1, CENY - Player.y, SSD1351_BLACK, SSD1351_BLACK);
+/* drawBackground --- draw the screen background */
+
+void drawBackground(void)
+{
+#ifdef BAND_FRAME
+   // One operation for the lot, remembering where the player was, since
+   // they may move before the frame is sent
+   if (DlRecording) {
+      dlRecord(DL_BACKGROUND, 0, MAXY - 1, Player.x, Player.y, 0, 0, 0, 0, 0, NULL);
+      return;
    }
+#endif
+
+   drawBackgroundAt(Player.x, Player.y);
+}
+
 
-   if ((MAXPLAYX - Player.x) < CENX) {
-      fillRect((MAXPLAYX - Player.x) + CENX, 0, MAXX - 1, MAXY - 1, SSD1351_BLACK, SSD1351_BLACK);
+#ifdef BAND_FRAME
+/* dlReplay --- carry out one recorded drawing operation on the current band */
+
+static void dlReplay(const struct DL_CMD *cmd)
+{
+   switch (cmd->op) {
+   case DL_PIXEL:
+      drawPixel(cmd->a, cmd->b, cmd->c1);
+      break;
+   case DL_HLINE:
+      drawHline(cmd->a, cmd->b, cmd->c, cmd->c1);
+      break;
+   case DL_VLINE:
+      drawVline(cmd->a, cmd->b, cmd->c, cmd->c1);
+      break;
+   case DL_LINE:
+      drawLine(cmd->a, cmd->b, cmd->c, cmd->d, cmd->c1);
+      break;
+   case DL_FILLRECT:
+      fillRect(cmd->a, cmd->b, cmd->c, cmd->d, cmd->c1, cmd->c2);
+      break;
+   case DL_CIRCLE:
+      circle(cmd->a, cmd->b, cmd->c, cmd->c1, cmd->c2);
+      break;
+   case DL_RING:
+      circle(cmd->a, cmd->b, cmd->c, cmd->c1, -1);
+      break;
+   case DL_SPLITCIRCLE:
+      drawSplitCircle(cmd->a, cmd->b, cmd->c, cmd->d, cmd->e, cmd->c1, cmd->c2);
+      break;
+   case DL_SPLITRING:
+      drawSplitCircle(cmd->a, cmd->b, cmd->c, cmd->d, cmd->e, cmd->c1, -1);
+      break;
+   case DL_SECTOR:
+      fillSector(cmd->a, cmd->b, cmd->c, cmd->d, cmd->e, cmd->c1);
+      break;
+   case DL_SWEEP:
+      drawSweep(cmd->a, cmd->b, cmd->c1);
+      break;
+   case DL_ROUNDRECT:
+      fillRoundRect(cmd->a, cmd->b, cmd->c, cmd->d, cmd->e, cmd->c1, cmd->c2);
+      break;
+   case DL_TEXT:
+      setText(cmd->a, cmd->b, cmd->p);
+      break;
+   case DL_BITMAP:
+      renderBitmap(cmd->a, cmd->b, cmd->c, cmd->d, cmd->p, cmd->e, cmd->c1, cmd->c2);
+      break;
+   case DL_GREYFRAME:
+      greyFrame();
+      break;
+   case DL_BACKGROUND:
+      drawBackgroundAt(cmd->a, cmd->b);
+      break;
+   case DL_BLENDRECT:
+      blendRect(cmd->a, cmd->b, cmd->c, cmd->d, cmd->c1, cmd->c2, cmd->e);
+      break;
+   case DL_CLIP:
+      setClip(cmd->a, cmd->b, cmd->c, cmd->d);
+      break;
    }
+}
+
+
+/* updscreen --- draw the display list a band at a time, sending each band to the screen */
 
-   if ((MAXPLAYY - Player.y) < CENY) {
-      fillRect(0, (MAXPLAYY - Player.y) + CENY, MAXX - 1, MAXY - 1, SSD1351_BLACK, SSD1351_BLACK);
+static void updscreen(const uint8_t y1, const uint8_t y2)
+{
+   // Each band starts out black and gets every operation that touches
+   // it, in the order they were drawn. Anything not redrawn since the
+   // last update is lost, unlike with a whole frame buffer
+   int i;
+   int top, bottom;
+   const struct clip_t clip = Clip;
+   
+   DlRecording = false;
+   
+   for (FrameTop = (y1 / BAND_ROWS) * BAND_ROWS; FrameTop <= y2; FrameTop += BAND_ROWS) {
+      memset(Frame, 0, sizeof (Frame));
+      
+      // Every band starts with the clip rectangle the frame started with
+      Clip = DlClip;
+      frameClip();
+      
+      for (i = 0; i < DlLen; i++)
+         if ((DisplayList[i].yhi >= FrameTop) && (DisplayList[i].ylo < (FrameTop + BAND_ROWS)))
+            dlReplay(&DisplayList[i]);
+      
+      top = (FrameTop > y1) ? FrameTop : y1;
+      bottom = ((FrameTop + BAND_ROWS - 1) < y2) ? (FrameTop + BAND_ROWS - 1) : y2;
+      
+      updwindow(0, top, MAXX - 1, bottom);
+   }
+   
+   DlRecording = true;
+   DlLen = 0;
+   
+   Clip = clip;
+   DlClip = clip;
+   frameClip();    // FrameClip still belongs to the last band
+   
+   if (DlOverflow) {
+      printf("Display list full: increase DL_SIZE\n");
+      DlOverflow = false;
    }
 }
 
 
+/* updscreenDiff --- update the physical screen from the display list */
+
+static void updscreenDiff(void)
+{
+   // There's no copy of the previous frame to compare with, so send the lot
+   updscreen(0, MAXY - 1);
+}
+#endif
+
+
 /* drawRadarScreen --- draw the basic circular radar scope */
 
 void drawRadarScreen(const int radius, const bool rings, const bool axes)
@@ -1018,14 +2383,14 @@ void drawGatheredTargets(void)
    int t;
    
    for (t = 0; t < NTARGETS; t++) {
-      if (Target[t].active == false) {
-         circle(6, Target[t].y, Target[t].siz, SSD1351_WHITE, 1);
+      if ((Target.flags[t] & TARGET_ACTIVE) == 0) {
+         circle(6, Target.y[t], Target.siz[t], SSD1351_WHITE, 1);
 
-      if (Target[t].rings)
-         circle(12, Target[t].y, 2, SSD1351_WHITE, -1);
+      if (Target.flags[t] & TARGET_RINGS)
+         circle(12, Target.y[t], 2, SSD1351_WHITE, -1);
 
-      if (Target[t].axes)
-         drawPixel(12, Target[t].y, SSD1351_WHITE);
+      if (Target.flags[t] & TARGET_AXES)
+         drawPixel(12, Target.y[t], SSD1351_WHITE);
       }
    }
 }
@@ -1050,36 +2415,109 @@ void drawTimer(const unsigned int sweeps)
 }
 
 
-/* drawRadarVector --- draw the radial line representing the current scan vector */
+/* drawRadarVector --- draw the radar beam at the current scan angle */
 
 void drawRadarVector(const int radius, const int angle)
 {
-   // This function draws the radial line three times to make it
-   // appear more clearly on the rather slow LCD. A better way
-   // would be to draw a narrow sector (pie-slice) so that the
-   // pixels have time to fully darken before they get switched
-   // back to white. But that would require an efficient sector
-   // drawing routine, which we don't have (yet).
-   int x, y;
-   const float r = (float)radius;
+   // The beam is a narrow pie slice, so that the pixels have time to
+   // fully darken on the rather slow LCD before they get switched back
+   // to white. Two dimmer slices trail behind it. On the scanner
+   // angles they all come from the sweep table
+   if ((radius == SweepRadius) && ((angle % SCANNER_INC_DEGREES) == 0)) {
+      const int step = angle / SCANNER_INC_DEGREES;
+
+      drawSweep(step - 2, 0, TargetColr[0]);
+      drawSweep(step - 1, 0, TargetColr[2]);
+      drawSweep(step, 1, SSD1351_GREEN);
+   }
+   else {
+      fillSector(CENX, CENY, radius, angle - (2 * TRAIL_DEGREES), angle - TRAIL_DEGREES, TargetColr[0]);
+      fillSector(CENX, CENY, radius, angle - TRAIL_DEGREES, angle, TargetColr[2]);
+      fillSector(CENX, CENY, radius, angle, angle + SWEEP_DEGREES, SSD1351_GREEN);
+   }
+}
+
+
+/* gridCell --- return the grid row or column for a playfield co-ordinate, clamped to the grid */
+
+static int gridCell(const int v, const int n)
+{
+   if (v < 0)
+      return (0);
+   else if ((v >> CELL_SHIFT) >= n)
+      return (n - 1);
+   else
+      return (v >> CELL_SHIFT);
+}
+
+
+/* initTargetIndex --- put all the targets into the grid, and empty the index by bearing */
 
-   // 252us
-   x = (r * cos ((double)angle / RADTODEG)) + 0.49;
-   y = (r * sin ((double)angle / RADTODEG)) + 0.49;
+void initTargetIndex(void)
+{
+   // Targets don't move, so the grid never changes after this.
+   // Targets that get picked up stay in it, but are skipped
+   int i;
+   int row, col;
 
-   // 232us
-   drawLine(CENX, CENY, CENX + x, CENY + y, SSD1351_GREEN);
+   for (i = 0; i < BEARING_BUCKETS; i++)
+      BearingBucket[i] = NO_TARGET;
 
-   x = (r * cos ((double)(angle + 2) / RADTODEG)) + 0.49;
-   y = (r * sin ((double)(angle + 2) / RADTODEG)) + 0.49;
+   for (row = 0; row < GRID_ROWS; row++)
+      for (col = 0; col < GRID_COLS; col++)
+         Grid[row][col] = NO_TARGET;
 
-   // 232us
-   drawLine(CENX, CENY, CENX + x, CENY + y, SSD1351_GREEN);
+   for (i = NTARGETS - 1; i >= 0; i--) {
+      row = gridCell(Target.y[i], GRID_ROWS);
+      col = gridCell(Target.x[i], GRID_COLS);
 
-   x = (r * cos ((double)(angle + 4) / RADTODEG)) + 0.49;
-   y = (r * sin ((double)(angle + 4) / RADTODEG)) + 0.49;
+      Target.bucket[i] = NO_BUCKET;
+      Target.cellNext[i] = Grid[row][col];
+      Grid[row][col] = i;
+   }
 
-   drawLine(CENX, CENY, CENX + x, CENY + y, SSD1351_GREEN);
+   Bucketed = Player;
+}
+
+
+/* unlinkTarget --- take a target out of its bearing bucket */
+
+void unlinkTarget(const int t)
+{
+   if (Target.bucket[t] == NO_BUCKET)
+      return;
+
+   if (Target.prev[t] == NO_TARGET)
+      BearingBucket[Target.bucket[t]] = Target.next[t];
+   else
+      Target.next[Target.prev[t]] = Target.next[t];
+
+   if (Target.next[t] != NO_TARGET)
+      Target.prev[Target.next[t]] = Target.prev[t];
+
+   Target.bucket[t] = NO_BUCKET;
+}
+
+
+/* linkTarget --- put a target into the bucket for its bearing, if it's not already there */
+
+void linkTarget(const int t)
+{
+   const int k = Target.bearing[t] / BUCKET_WIDTH;
+
+   if (Target.bucket[t] == k)
+      return;
+
+   unlinkTarget(t);
+
+   Target.bucket[t] = k;
+   Target.prev[t] = NO_TARGET;
+   Target.next[t] = BearingBucket[k];
+
+   if (Target.next[t] != NO_TARGET)
+      Target.prev[Target.next[t]] = t;
+
+   BearingBucket[k] = t;
 }
 
 
@@ -1090,40 +2528,141 @@ void reCalculateBearings(void)
    // We need to know the bearing from the player to each of the radar
    // targets, so that we can rapidly update the display as the "beam" rotates.
    // In this function, we update the array of bearings and ranges after the
-   // player position has changed. 'atan2' computes the arctangent, giving a
-   // bearing, without the risk of dividing by zero. The result is -180 to +180
-   // degrees, so we add 360 to any negative bearings. Range is worked out by
-   // Pythagoras' theorem.
+   // player position has changed. 'iatan2' computes the arctangent, giving a
+   // bearing, without the risk of dividing by zero. The result is 0 to 360
+   // degrees, in fractions of a degree. Range is worked out by Pythagoras'
+   // theorem, and kept squared so that there's no square root to take.
+   // Only targets within SCANNER_RADIUS can ever echo, so only they are
+   // kept in the bearing buckets. We look at the grid cells around the
+   // old and new positions of the player, which finds every target that
+   // has come into range and every one that has gone out of it.
+   const int r2 = SCANNER_RADIUS * SCANNER_RADIUS;
+   const int x1 = (int)((Player.x < Bucketed.x) ? Player.x : Bucketed.x) - SCANNER_RADIUS;
+   const int y1 = (int)((Player.y < Bucketed.y) ? Player.y : Bucketed.y) - SCANNER_RADIUS;
+   const int x2 = (int)((Player.x > Bucketed.x) ? Player.x : Bucketed.x) + SCANNER_RADIUS;
+   const int y2 = (int)((Player.y > Bucketed.y) ? Player.y : Bucketed.y) + SCANNER_RADIUS;
+   const int col1 = gridCell(x1, GRID_COLS);
+   const int col2 = gridCell(x2, GRID_COLS);
+   const int row2 = gridCell(y2, GRID_ROWS);
+   int row, col;
    int i;
 
-   for (i = 0; i < NTARGETS; i++) {
-      if (Target[i].active) {
-         const int dx = Target[i].x - Player.x;
-         const int dy = Target[i].y - Player.y;
-
-         Target[i].bearing = atan2(dy, dx) * RADTODEG;
-         Target[i].range = sqrt((dx * dx) + (dy * dy));
-
-         if (Target[i].bearing < 0.0)
-            Target[i].bearing += 360.0;
+   for (row = gridCell(y1, GRID_ROWS); row <= row2; row++) {
+      for (col = col1; col <= col2; col++) {
+         for (i = Grid[row][col]; i != NO_TARGET; i = Target.cellNext[i]) {
+            if (Target.flags[i] & TARGET_ACTIVE) {
+               const int dx = Target.x[i] - Player.x;
+               const int dy = Target.y[i] - Player.y;
+               const int d2 = (dx * dx) + (dy * dy);
+
+               if (d2 < r2) {
+                  Target.bearing[i] = iatan2(dy, dx);
+                  Target.range2[i] = d2;
+                  linkTarget(i);
+               }
+               else
+                  unlinkTarget(i);
+            }
+         }
       }
    }
+
+   Bucketed = Player;
+   BonusCheck = -1;
 }
 
 
-/* findEchoSlot --- search the Echo array for an unused slot */
+/* initEchoes --- put all the echoes on the free list */
 
-int findEchoSlot(void)
+void initEchoes(void)
 {
    int e;
-   
+
    for (e = 0; e < NECHOES; e++) {
-      if (Echo[e].age <= 0)
-         return (e);
+      Echo[e].age = 0;
+      Echo[e].next = (e < (NECHOES - 1)) ? (e + 1) : NO_ECHO;
+   }
+
+   EchoFree = 0;
+   EchoHead = NO_ECHO;
+   EchoTail = NO_ECHO;
+}
+
+
+/* newEcho --- add an echo to the tail of the live list, reusing the oldest one if none are free */
+
+int newEcho(void)
+{
+   int e;
+
+   if (EchoFree != NO_ECHO) {
+      e = EchoFree;
+      EchoFree = Echo[e].next;
+   }
+   else {
+      e = EchoHead;
+      EchoHead = Echo[e].next;
+
+      if (EchoHead == NO_ECHO)
+         EchoTail = NO_ECHO;
+   }
+
+   Echo[e].next = NO_ECHO;
+
+   if (EchoTail == NO_ECHO)
+      EchoHead = e;
+   else
+      Echo[EchoTail].next = e;
+
+   EchoTail = e;
+
+   return (e);
+}
+
+
+/* drawEchoes --- draw the live echoes and age them, freeing any that have faded out */
+
+void drawEchoes(void)
+{
+   int e;
+
+   for (e = EchoHead; e != NO_ECHO; e = Echo[e].next) {
+      const uint16_t colr = TargetColr[(Echo[e].age + 22) / 45];
+
+      circle(Echo[e].x, Echo[e].y, Echo[e].rad, colr, colr);
+      Echo[e].age -= SCANNER_INC_DEGREES;
+   }
+
+   // Oldest first, so all the dead ones are at the head
+   while ((EchoHead != NO_ECHO) && (Echo[EchoHead].age <= 0)) {
+      e = EchoHead;
+      EchoHead = Echo[e].next;
+      Echo[e].next = EchoFree;
+      EchoFree = e;
+   }
+
+   if (EchoHead == NO_ECHO)
+      EchoTail = NO_ECHO;
+}
+
+
+/* checkBonus --- give the player any bonus from a target within pickup range */
+
+void checkBonus(const int t)
+{
+   if (Target.flags[t] & TARGET_RINGS)
+      Rings = true;      // Enable range rings
+    
+   if (Target.flags[t] & TARGET_AXES)
+      Axes = true;       // Enable axes
+    
+   if (Target.flags[t] & TARGET_TIME) {
+      if (GameDuration < MAXGAMEDURATION)    // Give user more time
+         GameDuration += 5;
+    
+      Target.flags[t] &= ~TARGET_TIME;  // Only trigger once!
+      printf("More time: Target[%d] (%d,%d)\n", t, Target.x[t], Target.y[t]);
    }
-   
-   // We didn't find an empty slot, so overwrite slot 0  
-   return (0);
 }
 
 
@@ -1136,47 +2675,55 @@ void findNewEchoes(const int r, const int range, const int nt)
    // Some potential additions here: targets that are close to the radar
    // appear larger; make some echoes fade more quickly; give echoes
    // shapes other than circles.
-   int t;
+   // Only the buckets that overlap the beam are searched, and bonuses
+   // only depend on range, so they need checking again only after the
+   // player has moved. The buckets only hold targets that are within
+   // SCANNER_RADIUS, so 'range' can't be any bigger than that.
+   int t, next;
    int e;
-   const float frange = (float)range;
-   const float pickup = frange / 3.0;
-
-   for (t = 0; t < nt; t++) {
-      if (Target[t].active) {                            // Currently active?
-         if (abs(Target[t].bearing - (float)r) < 6.0) {  // In the right direction?
-           if (Target[t].range < frange) {               // Close enough?
+   int k;
+   const int pickup = range / 3;
+   const int range2 = range * range;
+   const int pickup2 = pickup * pickup;
+   const int klo = floorDiv(((r - ECHO_DEGREES) * DEG_SCALE) + 1, BUCKET_WIDTH);
+   const int khi = floorDiv(((r + ECHO_DEGREES) * DEG_SCALE) - 1, BUCKET_WIDTH);
+
+   for (k = (klo < 0) ? 0 : klo; (k <= khi) && (k < BEARING_BUCKETS); k++) {
+      for (t = BearingBucket[k]; t != NO_TARGET; t = next) {
+         next = Target.next[t];                          // Picking it up takes it out of the list
+
+         if (t >= nt)
+            continue;
+
+         if (abs(Target.bearing[t] - (r * DEG_SCALE)) < (ECHO_DEGREES * DEG_SCALE)) {  // In the right direction?
+           if (Target.range2[t] < range2) {              // Close enough?
               // Make a new echo
-              e = findEchoSlot();
-              Echo[e].x = CENX + (Target[t].x - Player.x);  // Make player-relative co-ordinates
-              Echo[e].y = CENY + (Target[t].y - Player.y);
+              e = newEcho();
+              Echo[e].x = CENX + (Target.x[t] - Player.x);  // Make player-relative co-ordinates
+              Echo[e].y = CENY + (Target.y[t] - Player.y);
               Echo[e].age = 270;                            // Echoes last 3/4 of a revolution
-              Echo[e].rad = Target[t].siz;                  // Target size affects echo size
+              Echo[e].rad = Target.siz[t];                  // Target size affects echo size
              
-              if (Target[t].range < pickup) {  // Pick it up?
-                 Target[t].active = false;
-                 Target[t].y = Gather_y;
+              if (Target.range2[t] < pickup2) {  // Pick it up?
+                 Target.flags[t] &= ~TARGET_ACTIVE;
+                 Target.y[t] = Gather_y;
                  Gather_y += 6;
+                 unlinkTarget(t);
+                 checkBonus(t);
               }
            }
          }
-
-         if (Target[t].range < pickup) {  // Close enough for bonus (regardless of bearing)?
-            if (Target[t].rings)
-               Rings = true;      // Enable range rings
-             
-            if (Target[t].axes)
-               Axes = true;       // Enable axes
-             
-            if (Target[t].time) {
-               if (GameDuration < MAXGAMEDURATION)    // Give user more time
-                  GameDuration += 5;
-             
-               Target[t].time = false;  // Only trigger once!
-               printf("More time: Target[%d] (%d,%d)\n", t, Target[t].x, Target[t].y);
-            }
-         }
       }
    }
+
+   if (BonusCheck != pickup) {
+      for (k = 0; k < BEARING_BUCKETS; k++)
+         for (t = BearingBucket[k]; t != NO_TARGET; t = Target.next[t])
+            if ((t < nt) && (Target.range2[t] < pickup2))   // Close enough for bonus (regardless of bearing)?
+               checkBonus(t);
+
+      BonusCheck = pickup;
+   }
 }
 
 
@@ -1303,6 +2850,10 @@ void game_setup(void)
    
    OLED_begin(MAXX, MAXY);
    
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+   
    greyFrame();
     
    updscreen(0, MAXY - 1);
@@ -1314,38 +2865,39 @@ void game_setup(void)
    // Targets scattered on playfield at random
    for (i = 0; i < NTARGETS; i++) {
       do {
-         Target[i].x = random(0, MAXPLAYX);
-         Target[i].y = random(0, MAXPLAYY);
+         Target.x[i] = random(0, MAXPLAYX);
+         Target.y[i] = random(0, MAXPLAYY);
       
-         Target[i].active = true;
-         Target[i].rings = false;
-         Target[i].axes = false;
-         Target[i].time = false;
-         Target[i].siz = random(1, 3);
-         printf("%d: (%d, %d) siz: %d\n", i, Target[i].x, Target[i].y, Target[i].siz);
+         Target.flags[i] = TARGET_ACTIVE;
+         Target.siz[i] = random(1, 3);
+         printf("%d: (%d, %d) siz: %d\n", i, Target.x[i], Target.y[i], Target.siz[i]);
          // TODO: make sure no two targets are too close together
       } while (0);
    }
   
    // Place the 'bonus' targets somewhere
    i = random (0, NTARGETS - 1);
-   Target[i].rings = true;
+   Target.flags[i] |= TARGET_RINGS;
 
    i = random (0, NTARGETS - 1);
-   Target[i].axes = true;
+   Target.flags[i] |= TARGET_AXES;
 
    i = random (0, NTARGETS - 1);
-   Target[i].time = true;
+   Target.flags[i] |= TARGET_TIME;
 
    i = random (0, NTARGETS - 1);
-   Target[i].time = true;
+   Target.flags[i] |= TARGET_TIME;
 
    // Start the player in centre of playfield
    Player.x = MAXPLAYX / 2;
    Player.y = MAXPLAYY / 2;
    
+   initTargetIndex();
+   initEchoes();
    reCalculateBearings();
 
+   sweepSetup(SCANNER_RADIUS);
+
    drawBackground();
 
    drawRadarScreen(SCANNER_RADIUS, true, true);
@@ -1375,13 +2927,13 @@ void game_loop(void)
    static unsigned int sweeps = 0;
    int r;
    int dir;
-   int e;
    long int start, now;
    int elapsed;
 
    for (r = 0; r < 360; r += SCANNER_INC_DEGREES) {
       // Record timer in milliseconds at start of frame cycle
       start = millis();
+      BytesSent = 0;
 
       // Draw empty radar scope
       drawBackground();
@@ -1406,14 +2958,7 @@ void game_loop(void)
       findNewEchoes(r, SCANNER_RADIUS, NTARGETS);
 
       // Add un-faded echoes
-      for (e = 0; e < NECHOES; e++) {
-         if (Echo[e].age > 0) {
-            const uint16_t colr = TargetColr[(Echo[e].age + 22) / 45];
-            circle(Echo[e].x, Echo[e].y, Echo[e].rad, colr, colr);
-         }
-         
-         Echo[e].age -= SCANNER_INC_DEGREES;
-      }
+      drawEchoes();
     
       if (r == 180)
          sweeps++;
@@ -1426,13 +2971,13 @@ void game_loop(void)
       }
       
       // Update LCD for this frame
-      updscreen(0, MAXY - 1);
+      updscreenDiff();
       
       // Work out timing for this frame
       now = millis();
       elapsed = now - start;
     
-//    printf("%dms.\n", elapsed);
+//    printf("%dms. %ld bytes\n", elapsed, BytesSent);
     
       if (elapsed < 40)
          delay(40 - elapsed);
@@ -0,0 +1,145 @@
+/* bandtest --- draw a scripted game and save what the simulated OLED shows */
+
+// Built for the host by 'make check', once with the whole frame buffer
+// and once with BAND_FRAME, with the firmware included whole. Each build
+// writes the screen after every frame to the file named on the command
+// line, and 'make check' compares the files: drawing a band at a time
+// from the display list must give exactly the same pictures.
+
+#define main risible_main
+#include "RisibleRadar.c"
+#undef main
+
+#include <stdio.h>
+
+#include "oledsim.h"
+
+#define NFRAMES  (60)
+
+
+/* setupTargets --- place the targets where they'll be found without random() */
+
+static void setupTargets(void)
+{
+   int i;
+
+   for (i = 0; i < NTARGETS; i++) {
+      Target.x[i] = ((i * 97) + 31) % MAXPLAYX;
+      Target.y[i] = ((i * 59) + 83) % MAXPLAYY;
+      Target.siz[i] = (i % 3) + 1;
+      Target.flags[i] = TARGET_ACTIVE;
+   }
+
+   Target.flags[1] |= TARGET_RINGS;
+   Target.flags[2] |= TARGET_AXES;
+
+   // Some already gathered, to be drawn down the side
+   Target.flags[3] = 0;
+   Target.flags[6] = 0;
+
+   Player.x = MAXPLAYX / 2;
+   Player.y = MAXPLAYY / 2;
+
+   initTargetIndex();
+   initEchoes();
+   reCalculateBearings();
+}
+
+
+/* drawFrame --- draw one frame with as many of the primitives as we can */
+
+static void drawFrame(const int frame)
+{
+   const int r = (frame * SCANNER_INC_DEGREES * 5) % 360;
+   int i;
+
+   if (frame == 0)
+      greyFrame();
+   else
+      drawBackground();
+
+   drawRadarScreen(SCANNER_RADIUS, frame & 1, frame & 2);
+   drawGatheredTargets();
+
+   if ((frame % 4) == 1)
+      renderBitmap(0, 0, 24, 24, &Arrows[0][0], 240, SSD1351_GREEN, SSD1351_BLACK);
+
+   if ((frame % 4) == 2)
+      setText(0, 0, "West");
+
+   if ((frame % 6) == 5) {
+      movePlayer(EAST);
+      reCalculateBearings();
+   }
+
+   drawRadarVector(SCANNER_RADIUS, r);
+   findNewEchoes(r, SCANNER_RADIUS, NTARGETS);
+   drawEchoes();
+
+   for (i = 0; i < 5; i++)
+      circle(10 + (((frame * 7) + (i * 29)) % 100), 10 + (((frame * 11) + (i * 17)) % 100), 2 + i, TargetColr[i], TargetColr[i + 1]);
+
+   drawLine(-5, 3, 140, 120, SSD1351_RED);
+   drawLine(frame, 127, 127 - frame, 0, SSD1351_GREEN);
+   fillRect(100, 100, 120, 127, SSD1351_WHITE, SSD1351_BLUE);
+   blendRect(20, 70 + (frame % 20), 60, 90 + (frame % 20), SSD1351_YELLOW, frame % 3, 20);
+   fillRoundRect(70, 8, 110, 30, frame % 12, SSD1351_CYAN, SSD1351_MAGENTA);
+
+   // Clipped drawing, which BAND_FRAME replays band by band
+   setClip(30, 40 + (frame % 8), 90, 88);
+   circle(CENX, CENY, 30, SSD1351_WHITE, SSD1351_RED);
+   fillSector(CENX, CENY, 40, frame * 6, (frame * 6) + 50, SSD1351_GREEN);
+   resetClip();
+
+   drawTimer(frame % 40);
+
+   if ((frame % 10) == 9)
+      textRoundRect("GAME OVER", SSD1351_WHITE, SSD1351_BLACK, SSD1351_WHITE);
+}
+
+
+int main(int argc, char *argv[])
+{
+   int frame;
+   int x, y;
+   uint16_t screen[MAXY][MAXX];
+   FILE *fp;
+
+   if (argc != 2) {
+      fprintf(stderr, "Usage: %s <screens>\n", argv[0]);
+      return (EXIT_FAILURE);
+   }
+
+   if ((fp = fopen(argv[1], "wb")) == NULL) {
+      perror(argv[1]);
+      return (EXIT_FAILURE);
+   }
+
+   simBegin();
+
+   initSPI();
+   OLED_begin(MAXX, MAXY);
+
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+
+   setupTargets();
+   sweepSetup(SCANNER_RADIUS);
+
+   for (frame = 0; frame < NFRAMES; frame++) {
+      drawFrame(frame);
+      updscreenDiff();
+      simSettle();
+
+      for (y = 0; y < MAXY; y++)
+         for (x = 0; x < MAXX; x++)
+            screen[y][x] = simScreen(x, y);
+
+      fwrite(screen, sizeof (screen), 1, fp);
+   }
+
+   fclose(fp);
+
+   return (simReport("bandtest"));
+}
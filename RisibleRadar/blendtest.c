@@ -0,0 +1,183 @@
+/* blendtest --- check the RGB565 blend kernels against a component-by-component reference */
+
+// Built for the host by 'make check', with the firmware included whole,
+// once with the portable C kernels and once with __ARM_FEATURE_DSP, which
+// runs the Cortex-M4 SIMD path through the C versions of the intrinsics
+// in the host stm32f4xx.h. Every BLEND_OP and every alpha from 0 to 32
+// is run over pairs of colours that between them take every value of
+// each component, with a different colour in each half of the word. Then
+// blendRect() is run over random rectangles of random pixels, which puts
+// blendSpan() through every alignment and length, and must change just
+// the pixels inside the clipped rectangle, each as the reference would.
+
+#define main risible_main
+#include "RisibleRadar.c"
+#undef main
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "oledsim.h"
+
+#define NSWEEP   (64)       // Colours that take every value of each component
+#define NRANDOM  (64)       // And some mixtures
+#define NCOLOURS (NSWEEP + NRANDOM)
+#define NRECTS   (2000)
+
+uint16_t Colours[NCOLOURS];
+pixel_t Before[MAXY][MAXX];
+
+
+/* refComponent --- combine one component of two pixels, 'max' being its full brightness */
+
+static int refComponent(const int op, const int f, const int b, const int alpha, const int max)
+{
+   switch (op) {
+   case BLEND_ADD:
+      return (((f + b) > max) ? max : (f + b));
+   case BLEND_MULTIPLY:
+      return (((f * b) + max) / (max + 1));
+   default:
+      return (((f * alpha) + (b * (32 - alpha))) / 32);
+   }
+}
+
+
+/* refBlend --- combine two pixels one component at a time */
+
+static uint16_t refBlend(const int op, const uint16_t fg, const uint16_t bg, const int alpha)
+{
+   const int r = refComponent(op, fg >> 11, bg >> 11, alpha, 0x1f);
+   const int g = refComponent(op, (fg >> 5) & 0x3f, (bg >> 5) & 0x3f, alpha, 0x3f);
+   const int b = refComponent(op, fg & 0x1f, bg & 0x1f, alpha, 0x1f);
+
+   return ((r << 11) | (g << 5) | b);
+}
+
+
+/* makeColours --- fill 'Colours' with a sweep of each component and some random mixtures */
+
+static void makeColours(void)
+{
+   int i;
+
+   // Over any two of the sweep, each component takes every pair of values
+   for (i = 0; i < NSWEEP; i++)
+      Colours[i] = ((i & 0x1f) << 11) | (i << 5) | (0x1f - (i & 0x1f));
+
+   for (i = NSWEEP; i < NCOLOURS; i++)
+      Colours[i] = rand();
+}
+
+
+/* checkKernels --- return the number of pixels where blend565x2() differs from the reference */
+
+static uint32_t checkKernels(const int op)
+{
+   int i, j, alpha;
+   uint32_t bad = 0;
+
+   for (alpha = 0; alpha <= 32; alpha++) {
+      for (i = 0; i < NCOLOURS; i++) {
+         for (j = 0; j < NCOLOURS; j++) {
+            const uint16_t fg0 = Colours[i];
+            const uint16_t fg1 = Colours[(i * 7) % NCOLOURS];
+            const uint16_t bg0 = Colours[j];
+            const uint16_t bg1 = Colours[(j + 1) % NCOLOURS];
+            const uint32_t w = blend565x2(op, fg0 | ((uint32_t)fg1 << 16), bg0 | ((uint32_t)bg1 << 16), alpha);
+
+            bad += (w & 0xffff) != refBlend(op, fg0, bg0, alpha);
+            bad += (w >> 16) != refBlend(op, fg1, bg1, alpha);
+         }
+      }
+
+      // Add and multiply don't use alpha
+      if (op != BLEND_ALPHA)
+         break;
+   }
+
+   return (bad);
+}
+
+
+/* checkRects --- return the number of pixels that blendRect() gets wrong */
+
+static uint32_t checkRects(void)
+{
+   int i, x, y;
+   int x1, y1, x2, y2;
+   int cx1, cy1, cx2, cy2;
+   uint32_t bad = 0;
+
+   for (i = 0; i < NRECTS; i++) {
+      const int op = i % 3;
+      const int alpha = rand() % 33;
+      const uint16_t c = Colours[rand() % NCOLOURS];
+
+      for (y = 0; y < MAXY; y++)
+         for (x = 0; x < MAXX; x++)
+            Frame[y][x] = Colours[rand() % NCOLOURS];
+
+      memcpy(Before, Frame, sizeof (Frame));
+
+      x1 = (rand() % (MAXX + 20)) - 10;
+      y1 = (rand() % (MAXY + 20)) - 10;
+      x2 = x1 + (rand() % 40) - 2;
+      y2 = y1 + (rand() % 40) - 2;
+
+      cx1 = rand() % 20;
+      cy1 = rand() % 20;
+      cx2 = (MAXX - 1) - (rand() % 20);
+      cy2 = (MAXY - 1) - (rand() % 20);
+
+      setClip(cx1, cy1, cx2, cy2);
+      blendRect(x1, y1, x2, y2, c, op, alpha);
+      resetClip();
+
+      for (y = 0; y < MAXY; y++) {
+         for (x = 0; x < MAXX; x++) {
+            const bool in = (x >= x1) && (x <= x2) && (y >= y1) && (y <= y2) &&
+                            (x >= cx1) && (x <= cx2) && (y >= cy1) && (y <= cy2);
+
+            if (Frame[y][x] != (in ? refBlend(op, c, Before[y][x], alpha) : Before[y][x]))
+               bad++;
+         }
+      }
+   }
+
+   return (bad);
+}
+
+
+int main(void)
+{
+   static const char *const names[3] = {"BLEND_ALPHA", "BLEND_ADD", "BLEND_MULTIPLY"};
+   uint32_t bad;
+   int op;
+
+   simBegin();
+
+   initSPI();
+   OLED_begin(MAXX, MAXY);
+
+   srand(14);
+   makeColours();
+
+   for (op = BLEND_ALPHA; op <= BLEND_MULTIPLY; op++) {
+      bad = checkKernels(op);
+
+      if (bad != 0)
+         printf("%s: %u pixels wrong\n", names[op], bad);
+
+      CHECK(bad == 0);
+   }
+
+   bad = checkRects();
+
+   if (bad != 0)
+      printf("blendRect: %u pixels wrong\n", bad);
+
+   CHECK(bad == 0);
+
+   return (simReport("blendtest"));
+}
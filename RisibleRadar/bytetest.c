@@ -0,0 +1,141 @@
+/* bytetest --- count the bytes each frame sends to a simulated OLED */
+
+// Built for the host by 'make check', with the firmware included whole.
+// SHADOW_FRAME is on, so that only the changes are sent.
+// A scripted game runs for two sweeps of the scanner. After each frame
+// the simulated OLED must show exactly what's in the frame buffer, and
+// BytesSent must agree with the bytes the OLED received. The average
+// bytes per frame is printed beside the cost of sending every pixel.
+
+#define main risible_main
+#include "RisibleRadar.c"
+#undef main
+
+#include <stdio.h>
+
+#include "oledsim.h"
+
+#define NFRAMES  (2 * SWEEP_STEPS)
+
+#define FULL_FRAME_BYTES  (7 + (MAXX * MAXY * 2))   // Window commands and every pixel
+
+
+/* rgb --- return the RGB565 colour the OLED should get for a frame buffer pixel */
+
+static uint16_t rgb(const pixel_t p)
+{
+#ifdef INDEXED_FRAME
+   return (Palette[p]);
+#else
+   return (p);
+#endif
+}
+
+
+/* sameAsFrame --- return true if the OLED shows what's in the frame buffer */
+
+static bool sameAsFrame(void)
+{
+   int x, y;
+
+   for (y = 0; y < MAXY; y++)
+      for (x = 0; x < MAXX; x++)
+         if (simScreen(x, y) != rgb(Frame[y][x]))
+            return (false);
+
+   return (true);
+}
+
+
+/* setupTargets --- place the targets where they'll be found without random() */
+
+static void setupTargets(void)
+{
+   int i;
+
+   for (i = 0; i < NTARGETS; i++) {
+      Target.x[i] = ((i * 97) + 31) % MAXPLAYX;
+      Target.y[i] = ((i * 59) + 83) % MAXPLAYY;
+      Target.siz[i] = (i % 3) + 1;
+      Target.flags[i] = TARGET_ACTIVE;
+   }
+
+   Target.flags[1] |= TARGET_RINGS;
+   Target.flags[2] |= TARGET_AXES;
+
+   Player.x = MAXPLAYX / 2;
+   Player.y = MAXPLAYY / 2;
+
+   initTargetIndex();
+   initEchoes();
+   reCalculateBearings();
+}
+
+
+int main(void)
+{
+   int frame;
+   int r = 0;
+   uint32_t bytes, total = 0, most = 0;
+   bool ok = true;
+
+   simBegin();
+
+   initSPI();
+   OLED_begin(MAXX, MAXY);
+
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+
+   greyFrame();
+   updscreen(0, MAXY - 1);
+   CHECK(sameAsFrame());
+
+   setupTargets();
+   sweepSetup(SCANNER_RADIUS);
+
+   for (frame = 0; frame < NFRAMES; frame++) {
+      BytesSent = 0;
+      bytes = Oled.bytes;
+
+      // As game_loop() does, with the player wandering about
+      drawBackground();
+      drawRadarScreen(SCANNER_RADIUS, Rings, Axes);
+      drawGatheredTargets();
+
+      if ((frame % 8) == 3) {
+         movePlayer((frame & 16) ? NORTH : EAST);
+         reCalculateBearings();
+      }
+
+      drawRadarVector(SCANNER_RADIUS, r);
+      findNewEchoes(r, SCANNER_RADIUS, NTARGETS);
+      drawEchoes();
+      drawTimer(frame / SWEEP_STEPS);
+
+      updscreenDiff();
+
+      bytes = Oled.bytes - bytes;
+
+      CHECK(BytesSent == bytes);
+      ok &= sameAsFrame();
+
+      total += bytes;
+
+      if (bytes > most)
+         most = bytes;
+
+      r = (r + SCANNER_INC_DEGREES) % 360;
+   }
+
+   CHECK(ok);
+
+   // Sending only the changes has to be worth doing
+   CHECK(total < (NFRAMES * FULL_FRAME_BYTES));
+
+   printf("%d frames: %u bytes per frame on average, %u at most; whole frame is %d bytes\n",
+          NFRAMES, total / NFRAMES, most, FULL_FRAME_BYTES);
+
+   return (simReport("bytetest"));
+}
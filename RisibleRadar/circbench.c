@@ -0,0 +1,340 @@
+/* circbench --- count and time the pixel writes of circles and rounded rectangles */
+
+// Built for the host by 'make bench', with the firmware included whole.
+// The old circle code, which filled four spans and plotted eight edge
+// pixels at every step of Michener's algorithm, is kept here with a
+// count of the pixels it wrote. First old and new are run over assorted
+// shapes, on and off the screen and under assorted clip rectangles, and
+// must light exactly the same pixels. Then the writes and the times are
+// compared for the shapes the game draws. The new code writes each
+// pixel once, so its writes are the pixels that the shape covers.
+
+#define main risible_main
+#include "RisibleRadar.c"
+#undef main
+
+#include <stdio.h>
+
+#include "oledsim.h"
+
+#ifndef CIRCLE_LOOPS
+#define CIRCLE_LOOPS  (20000)
+#endif
+
+#define BACKGROUND  (SSD1351_BLUE)    // Neither edge nor fill colour
+
+pixel_t Ref[MAXY][MAXX];
+
+uint32_t OldWrites = 0;
+
+
+/* oldHline --- draw a horizontal line, counting its pixels */
+
+static void oldHline(const int x1, const int x2, const int y, const uint16_t c)
+{
+   if (x2 >= x1)
+      OldWrites += (x2 - x1) + 1;
+
+   drawHline(x1, x2, y, c);
+}
+
+
+/* oldVline --- draw a vertical line, counting its pixels */
+
+static void oldVline(const int x, const int y1, const int y2, const uint16_t c)
+{
+   if (y2 >= y1)
+      OldWrites += (y2 - y1) + 1;
+
+   drawVline(x, y1, y2, c);
+}
+
+
+/* oldPixel --- draw one pixel, counting it */
+
+static void oldPixel(const int x, const int y, const uint16_t c)
+{
+   OldWrites++;
+   drawPixel(x, y, c);
+}
+
+
+/* splitcfill --- draw horizontal lines to fill a circle */
+
+static void splitcfill(const int x0, const int y0, const int x1, const int y1, const int x, const int y, const int c)
+{
+   oldHline(x0 - x, x1 + x, y1 + y, c);
+   oldHline(x0 - x, x1 + x, y0 - y, c);
+   oldHline(x0 - y, x1 + y, y1 + x, c);
+   oldHline(x0 - y, x1 + y, y0 - x, c);
+}
+
+
+/* splitcpts4 --- draw four pixels to form the edge of a split circle */
+
+static void splitcpts4(const int x0, const int y0, const int x1, const int y1, const int x, const int y, const int c)
+{
+   oldPixel(x1 + x, y1 + y, c);
+   oldPixel(x0 - x, y1 + y, c);
+   oldPixel(x1 + x, y0 - y, c);
+   oldPixel(x0 - x, y0 - y, c);
+}
+
+
+/* splitcpts8 --- draw eight pixels to form the edge of a split circle */
+
+static void splitcpts8(const int x0, const int y0, const int x1, const int y1, const int x, const int y, const int c)
+{
+   splitcpts4(x0, y0, x1, y1, x, y, c);
+   splitcpts4(x0, y0, x1, y1, y, x, c);
+}
+
+
+/* oldSplitCircle --- draw a split circle with edge and fill colours, as before */
+
+static void oldSplitCircle(const int x0, const int y0, const int x1, const int y1, const int r, const int ec, const int fc)
+{
+   // Michener's circle algorithm. Originally coded on the IBM PC
+   // with EGA card in 1986.
+   int x, y;
+   int d;
+
+   x = 0;
+   y = r;
+   d = 3 - (2 * r);
+
+   if (fc >= 0) {
+      while (x < y) {
+         splitcfill(x0, y0, x1, y1, x, y, fc);
+         if (d < 0) {
+            d += (4 * x) + 6;
+         }
+         else {
+            d += (4 * (x - y)) + 10;
+            y--;
+         }
+         x++;
+      }
+
+      if (x == y)
+         splitcfill(x0, y0, x1, y1, x, y, fc);
+   }
+
+   x = 0;
+   y = r;
+   d = 3 - (2 * r);
+
+   while (x < y) {
+      splitcpts8(x0, y0, x1, y1, x, y, ec);
+      if (d < 0) {
+         d += (4 * x) + 6;
+      }
+      else {
+         d += (4 * (x - y)) + 10;
+         y--;
+      }
+      x++;
+   }
+
+   if (x == y)
+      splitcpts8(x0, y0, x1, y1, x, y, ec);
+}
+
+
+/* oldCircle --- draw a circle with edge and fill colours, as before */
+
+static void oldCircle(const int x0, const int y0, const int r, const int ec, const int fc)
+{
+   // The old cfill() and cpts8() were splitcfill() and splitcpts8()
+   // with both centres the same
+   oldSplitCircle(x0, y0, x0, y0, r, ec, fc);
+}
+
+
+/* oldRoundRect --- fill a rounded rectangle, as before */
+
+static void oldRoundRect(const int x0, const int y0, const int x1, const int y1, const int r, const uint16_t ec, const uint16_t fc)
+{
+   int y;
+
+   oldSplitCircle(x0 + r, y0 + r, x1 - r, y1 - r, r, ec, fc);
+
+   oldHline(x0 + r, x1 - r, y0, ec);
+   oldHline(x0 + r, x1 - r, y1, ec);
+   oldVline(x0, y0 + r, y1 - r, ec);
+   oldVline(x1, y0 + r, y1 - r, ec);
+
+   for (y = y0 + r; y < (y1 - r); y++)
+      oldHline(x0 + 1, x1 - 1, y, fc);
+}
+
+
+/* drawShape --- draw one of the shapes with the old code or the new */
+
+static void drawShape(const bool old, const int kind, const int x, const int y, const int r, const int w, const int h)
+{
+   switch (kind) {
+   case 0:
+      if (old)
+         oldCircle(x, y, r, SSD1351_WHITE, SSD1351_RED);
+      else
+         circle(x, y, r, SSD1351_WHITE, SSD1351_RED);
+      break;
+   case 1:
+      if (old)
+         oldCircle(x, y, r, SSD1351_WHITE, -1);
+      else
+         circle(x, y, r, SSD1351_WHITE, -1);
+      break;
+   case 2:
+      if (old)
+         oldSplitCircle(x, y, x + w, y + h, r, SSD1351_WHITE, SSD1351_RED);
+      else
+         drawSplitCircle(x, y, x + w, y + h, r, SSD1351_WHITE, SSD1351_RED);
+      break;
+   case 3:
+      if (old)
+         oldRoundRect(x, y, x + (2 * r) + w, y + (2 * r) + h, r, SSD1351_WHITE, SSD1351_RED);
+      else
+         fillRoundRect(x, y, x + (2 * r) + w, y + (2 * r) + h, r, SSD1351_WHITE, SSD1351_RED);
+      break;
+   }
+}
+
+
+/* sameShapes --- return the number of shapes where old and new differ */
+
+static int sameShapes(void)
+{
+   int r, x, y, kind;
+   int n = 0, bad = 0;
+
+   for (r = 0; r <= 140; r += 3)
+      for (x = -30; x < (MAXX + 30); x += 17)
+         for (y = -30; y < (MAXY + 30); y += 13)
+            for (kind = 0; kind < 4; kind++) {
+               // The old code filled over the top edge of a square-cornered rectangle
+               if ((kind == 3) && (r == 0))
+                  continue;
+
+               if ((n % 3) == 0)
+                  setClip(n % 37, n % 23, (MAXX - 1) - (n % 41), (MAXY - 1) - (n % 19));
+               else
+                  resetClip();
+
+               memset(Frame, 0, sizeof (Frame));
+               drawShape(true, kind, x, y, r, n % 29, n % 17);
+               memcpy(Ref, Frame, sizeof (Frame));
+
+               memset(Frame, 0, sizeof (Frame));
+               drawShape(false, kind, x, y, r, n % 29, n % 17);
+
+               if (memcmp(Ref, Frame, sizeof (Frame)) != 0)
+                  bad++;
+
+               n++;
+            }
+
+   resetClip();
+
+   printf("%d shapes compared\n", n);
+
+   return (bad);
+}
+
+
+/* covered --- return the number of pixels not in the background colour */
+
+static uint32_t covered(void)
+{
+   const pixel_t bg = colourIndex(BACKGROUND);
+   uint32_t n = 0;
+   int x, y;
+
+   for (y = 0; y < MAXY; y++)
+      for (x = 0; x < MAXX; x++)
+         if (Frame[y][x] != bg)
+            n++;
+
+   return (n);
+}
+
+
+/* benchShape --- count and time the pixel writes of one shape, old and new */
+
+static void benchShape(const char *name, const int kind, const int x, const int y, const int r, const int w, const int h)
+{
+   int i;
+   uint32_t writes;
+   double t, told, tnew;
+
+   fillRect(0, 0, MAXX - 1, MAXY - 1, BACKGROUND, BACKGROUND);
+
+   OldWrites = 0;
+   drawShape(true, kind, x, y, r, w, h);
+   writes = OldWrites;
+
+   fillRect(0, 0, MAXX - 1, MAXY - 1, BACKGROUND, BACKGROUND);
+   drawShape(false, kind, x, y, r, w, h);
+
+   t = simSeconds();
+
+   for (i = 0; i < CIRCLE_LOOPS; i++)
+      drawShape(true, kind, x, y, r, w, h);
+
+   told = simSeconds() - t;
+   t = simSeconds();
+
+   for (i = 0; i < CIRCLE_LOOPS; i++)
+      drawShape(false, kind, x, y, r, w, h);
+
+   tnew = simSeconds() - t;
+
+   printf("%-12s %6u -> %6u pixels written, %6.0f -> %6.0f ns\n", name, writes, covered(),
+          (told * 1e9) / CIRCLE_LOOPS, (tnew * 1e9) / CIRCLE_LOOPS);
+}
+
+
+/* benchEdges --- time Michener's algorithm on its own */
+
+static void benchEdges(const int r)
+{
+   int i, n = 0;
+   double t;
+
+   t = simSeconds();
+
+   for (i = 0; i < CIRCLE_LOOPS; i++)
+      n += circleEdges(r);
+
+   t = simSeconds() - t;
+
+   printf("circleEdges(%d): %d steps, %.0f ns\n", r, n / CIRCLE_LOOPS, (t * 1e9) / CIRCLE_LOOPS);
+}
+
+
+int main(void)
+{
+   simBegin();
+
+   initSPI();
+   OLED_begin(MAXX, MAXY);
+
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+
+   CHECK(sameShapes() == 0);
+
+   benchEdges(SCANNER_RADIUS);
+   benchEdges(4);
+
+   // The radar scope, an echo, a split circle and the "GAME OVER" box
+   benchShape("Scope", 0, CENX, CENY, SCANNER_RADIUS, 0, 0);
+   benchShape("Echo", 0, CENX, CENY, 4, 0, 0);
+   benchShape("Ring", 1, CENX, CENY, SCANNER_RADIUS, 0, 0);
+   benchShape("Split circle", 2, CENX - 20, CENY - 10, 12, 40, 20);
+   benchShape("Round rect", 3, CENX - 41, CENY - 8, 7, 68, 6);
+
+   return (simReport("circbench"));
+}
@@ -0,0 +1,158 @@
+/* cliptest --- fuzz the drawing primitives against the clip rectangle */
+
+// Built for the host by 'make check', with the firmware included whole
+// and AddressSanitizer watching every store. Each primitive is drawn with
+// random arguments, many of them well off the screen, inside a random
+// clip rectangle. It is then drawn again from the same starting frame
+// with the clip reset to the whole screen. Inside the clip rectangle the
+// two must agree, and outside it nothing may have changed. A store
+// outside Frame stops the test with a report from the sanitizer.
+
+#define main risible_main
+#include "RisibleRadar.c"
+#undef main
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "oledsim.h"
+
+#define NDRAWS  (20000)
+#define NOPS    (12)
+
+pixel_t Before[MAXY][MAXX];
+pixel_t Clipped[MAXY][MAXX];
+
+
+/* rnd --- return a random integer from 'lo' to 'hi' inclusive */
+
+static int rnd(const int lo, const int hi)
+{
+   return (lo + (rand() % ((hi - lo) + 1)));
+}
+
+
+/* drawOne --- draw with one of the primitives */
+
+static void drawOne(const int op, const int x1, const int y1, const int x2, const int y2, const int r)
+{
+   switch (op) {
+   case 0:
+      drawPixel(x1, y1, SSD1351_RED);
+      break;
+   case 1:
+      drawLine(x1, y1, x2, y2, SSD1351_GREEN);
+      break;
+   case 2:
+      drawHline(x1, x2, y1, SSD1351_BLUE);
+      break;
+   case 3:
+      drawVline(x1, y1, y2, SSD1351_CYAN);
+      break;
+   case 4:
+      circle(x1, y1, r, SSD1351_WHITE, (r & 1) ? SSD1351_RED : -1);
+      break;
+   case 5:
+      fillRoundRect(x1, y1, x1 + r, y1 + (r / 2), r / 4, SSD1351_WHITE, SSD1351_BLUE);
+      break;
+   case 6:
+      setText(x1, y1, "Clip");
+      break;
+   case 7:
+      renderBitmap(x1, y1, 24, 24, &Arrows[0][0], 240, SSD1351_GREEN, SSD1351_BLACK);
+      break;
+   case 8:
+      fillRect(x1, y1, x2, y2, SSD1351_WHITE, SSD1351_MAGENTA);
+      break;
+   case 9:
+      blendRect(x1, y1, x2, y2, SSD1351_YELLOW, r % 3, r % 33);
+      break;
+   case 10:
+      drawSplitCircle(x1, y1, x1 + 20, y1 + 10, r % 20, SSD1351_WHITE, SSD1351_GREEN);
+      break;
+   case 11:
+      fillSector(x1, y1, r, x2, x2 + (y2 & 511), SSD1351_GREEN);
+      break;
+   }
+}
+
+
+int main(void)
+{
+   int i;
+   int x, y;
+   int cx1, cy1, cx2, cy2;
+   int x1, y1, x2, y2, r;
+   int op;
+   uint32_t bad[NOPS] = {0};
+
+   simBegin();
+
+   initSPI();
+   OLED_begin(MAXX, MAXY);
+
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+
+   greyFrame();
+   srand(15);
+
+   for (i = 0; i < NDRAWS; i++) {
+      op = i % NOPS;
+
+      // Half the shapes near the screen, half anywhere at all
+      if (i & 1) {
+         x1 = rnd(-20, MAXX + 20);
+         y1 = rnd(-20, MAXY + 20);
+         x2 = rnd(-20, MAXX + 20);
+         y2 = rnd(-20, MAXY + 20);
+         r = rnd(0, 40);
+      }
+      else {
+         x1 = rnd(-300, 300);
+         y1 = rnd(-300, 300);
+         x2 = rnd(-300, 300);
+         y2 = rnd(-300, 300);
+         r = rnd(0, 200);
+      }
+
+      // Including empty rectangles and ones hanging off the screen
+      cx1 = rnd(-10, MAXX + 10);
+      cy1 = rnd(-10, MAXY + 10);
+      cx2 = rnd(cx1 - 8, MAXX + 10);
+      cy2 = rnd(cy1 - 8, MAXY + 10);
+
+      memcpy(Before, Frame, sizeof (Frame));
+
+      setClip(cx1, cy1, cx2, cy2);
+      drawOne(op, x1, y1, x2, y2, r);
+      memcpy(Clipped, Frame, sizeof (Frame));
+
+      // The reference, clipped only by the edges of the screen
+      memcpy(Frame, Before, sizeof (Frame));
+      resetClip();
+      drawOne(op, x1, y1, x2, y2, r);
+
+      for (y = 0; y < MAXY; y++) {
+         for (x = 0; x < MAXX; x++) {
+            const bool in = (x >= cx1) && (x <= cx2) && (y >= cy1) && (y <= cy2);
+
+            if (Clipped[y][x] != (in ? Frame[y][x] : Before[y][x]))
+               bad[op]++;
+         }
+      }
+
+      // Carry on from the clipped picture, so that blendRect() sees a mixture
+      memcpy(Frame, Clipped, sizeof (Frame));
+   }
+
+   for (op = 0; op < NOPS; op++) {
+      if (bad[op] != 0)
+         printf("Primitive %d: %u pixels wrong\n", op, bad[op]);
+
+      CHECK(bad[op] == 0);
+   }
+
+   return (simReport("cliptest"));
+}
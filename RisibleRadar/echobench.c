@@ -0,0 +1,230 @@
+/* echobench --- time findNewEchoes() and its target index against a scan of every target */
+
+// Built for the host by 'make bench', once for each number of targets,
+// with the firmware included whole. oldBearings() and oldEchoes() are
+// the way it used to be done: every target's bearing worked out after
+// each move, and every target looked at on each step of the sweep.
+// First the index must hold exactly the targets that the scan would
+// find, on every step of several sweeps with the player moving about.
+// Then each way is timed over whole sweeps, and over moves of the
+// player. The times are the host's, so it's the ratios that count.
+
+#define main risible_main
+#include "RisibleRadar.c"
+#undef main
+
+#include <stdio.h>
+
+#include "oledsim.h"
+
+#define MIN_SECONDS  (0.2)    // Repeat each timing for at least this long
+#define NSWEEPS      (8)      // Sweeps to check the index over
+
+uint16_t OldBearing[NTARGETS];
+int32_t OldRange2[NTARGETS];
+
+
+/* oldBearings --- work out the bearing and range of every target */
+
+static void oldBearings(void)
+{
+   int i;
+
+   for (i = 0; i < NTARGETS; i++) {
+      const int dx = Target.x[i] - Player.x;
+      const int dy = Target.y[i] - Player.y;
+
+      OldBearing[i] = iatan2(dy, dx);
+      OldRange2[i] = (dx * dx) + (dy * dy);
+   }
+}
+
+
+/* oldHit --- return true if the scan of every target would make an echo of this one */
+
+static bool oldHit(const int t, const int r, const int range2)
+{
+   return ((Target.flags[t] & TARGET_ACTIVE) &&
+           (abs(OldBearing[t] - (r * DEG_SCALE)) < (ECHO_DEGREES * DEG_SCALE)) &&
+           (OldRange2[t] < range2));
+}
+
+
+/* oldEchoes --- look at every target for anything that will cause an echo */
+
+static void oldEchoes(const int r, const int range)
+{
+   int t, e;
+   const int range2 = range * range;
+
+   for (t = 0; t < NTARGETS; t++) {
+      if (oldHit(t, r, range2)) {
+         e = newEcho();
+         Echo[e].x = CENX + (Target.x[t] - Player.x);
+         Echo[e].y = CENY + (Target.y[t] - Player.y);
+         Echo[e].age = 270;
+         Echo[e].rad = Target.siz[t];
+      }
+   }
+}
+
+
+/* indexHits --- return the number of targets in the buckets searched for beam angle 'r' that echo */
+
+static int indexHits(const int r, const int range)
+{
+   const int range2 = range * range;
+   const int klo = floorDiv(((r - ECHO_DEGREES) * DEG_SCALE) + 1, BUCKET_WIDTH);
+   const int khi = floorDiv(((r + ECHO_DEGREES) * DEG_SCALE) - 1, BUCKET_WIDTH);
+   int k, t, n = 0;
+
+   for (k = (klo < 0) ? 0 : klo; (k <= khi) && (k < BEARING_BUCKETS); k++)
+      for (t = BearingBucket[k]; t != NO_TARGET; t = Target.next[t])
+         if (abs(Target.bearing[t] - (r * DEG_SCALE)) < (ECHO_DEGREES * DEG_SCALE))
+            if (Target.range2[t] < range2)
+               n++;
+
+   return (n);
+}
+
+
+/* setupTargets --- scatter the targets over the playfield */
+
+static void setupTargets(void)
+{
+   int i;
+
+   srand(21);
+
+   for (i = 0; i < NTARGETS; i++) {
+      Target.x[i] = rand() % MAXPLAYX;
+      Target.y[i] = rand() % MAXPLAYY;
+      Target.siz[i] = (rand() % 3) + 1;
+      Target.flags[i] = TARGET_ACTIVE;
+   }
+
+   Player.x = MAXPLAYX / 2;
+   Player.y = MAXPLAYY / 2;
+
+   initTargetIndex();
+   initEchoes();
+   reCalculateBearings();
+}
+
+
+/* move --- move the player one step of a wander round the playfield */
+
+static void move(const int i)
+{
+   static const int dir[4] = {EAST, SOUTH, WEST, NORTH};
+
+   movePlayer(dir[(i / 16) % 4]);
+}
+
+
+/* sameHits --- return the number of beam angles where the index and the scan disagree */
+
+static int sameHits(int *const hits)
+{
+   int i, r, t, n;
+   int bad = 0;
+   const int range2 = SCANNER_RADIUS * SCANNER_RADIUS;
+
+   *hits = 0;
+
+   for (i = 0; i < (NSWEEPS * SWEEP_STEPS); i++) {
+      if ((i % 5) == 0) {
+         move(i);
+         reCalculateBearings();
+      }
+
+      oldBearings();
+
+      r = (i % SWEEP_STEPS) * SCANNER_INC_DEGREES;
+
+      for (n = 0, t = 0; t < NTARGETS; t++)
+         n += oldHit(t, r, range2);
+
+      if (n != indexHits(r, SCANNER_RADIUS))
+         bad++;
+
+      *hits += n;
+   }
+
+   return (bad);
+}
+
+
+/* timeSweeps --- return the time for one sweep of findNewEchoes() or the old scan */
+
+static double timeSweeps(const bool old)
+{
+   int n = 0;
+   int r;
+   double t = simSeconds();
+
+   do {
+      for (r = 0; r < 360; r += SCANNER_INC_DEGREES) {
+         if (old)
+            oldEchoes(r, SCANNER_RADIUS);
+         else
+            findNewEchoes(r, SCANNER_RADIUS, NTARGETS);
+      }
+
+      n++;
+   } while ((simSeconds() - t) < MIN_SECONDS);
+
+   return ((simSeconds() - t) / n);
+}
+
+
+/* timeMoves --- return the time for the bearings to be brought up to date after a move */
+
+static double timeMoves(const bool old)
+{
+   int n = 0;
+   double t = simSeconds();
+
+   do {
+      move(n);
+
+      if (old)
+         oldBearings();
+      else
+         reCalculateBearings();
+
+      n++;
+   } while ((simSeconds() - t) < MIN_SECONDS);
+
+   return ((simSeconds() - t) / n);
+}
+
+
+int main(void)
+{
+   int hits;
+   double told, tnew;
+
+   simBegin();
+
+   setupTargets();
+
+   CHECK(sameHits(&hits) == 0);
+
+   // One sweep picks up the targets near the player, and then
+   // neither way has any more to pick up
+   timeSweeps(false);
+   oldBearings();
+
+   told = timeSweeps(true);
+   tnew = timeSweeps(false);
+
+   printf("%6d targets, %d beam hits per sweep: sweep %.1f -> %.1f us", NTARGETS, hits / NSWEEPS, told * 1e6, tnew * 1e6);
+
+   told = timeMoves(true);
+   tnew = timeMoves(false);
+
+   printf(", move %.1f -> %.1f us\n", told * 1e6, tnew * 1e6);
+
+   return (simReport("echobench"));
+}
@@ -0,0 +1,240 @@
+/* linebench --- time the run-slice drawLine() against the old pixel-at-a-time one */
+
+// Built for the host by 'make bench', with the firmware included whole.
+// oldLine() is drawLine() as it was before it filled whole runs. First
+// both are run over a grid of end points, on and off the screen and
+// under assorted clip rectangles, and must light exactly the same
+// pixels. Then each is timed drawing radar vectors, long diagonals and
+// full-screen horizontal and vertical lines. The times are the host's,
+// so it's the ratio between old and new that's worth comparing.
+
+#define main risible_main
+#include "RisibleRadar.c"
+#undef main
+
+#include <stdio.h>
+
+#include "oledsim.h"
+
+#ifndef LINE_LOOPS
+#define LINE_LOOPS  (20000)
+#endif
+
+pixel_t Ref[MAXY][MAXX];
+
+
+/* oldLine --- draw a line between any two absolute co-ords, as before */
+
+void oldLine(int x1, int y1, int x2, int y2, const int c)
+{
+   // Bresenham's line drawing algorithm. Originally coded on the IBM PC
+   // with EGA card in 1986.
+   int d;
+   int i1, i2;
+   int x, y;
+   int xend, yend;
+   int yinc, xinc;
+   int code1, code2;
+   bool inside;
+   pixel_t p;
+
+   const int dx = abs(x2 - x1);
+   const int dy = abs(y2 - y1);
+
+   code1 = outcode(x1, y1);
+   code2 = outcode(x2, y2);
+
+   if ((code1 & code2) != 0)
+      return;
+
+   inside = (code1 | code2) == 0;
+   p = colourIndex(c);
+
+   if (((y1 > y2) && (dx < dy)) || ((x1 > x2) && (dx >= dy))) {
+      int temp;
+
+      temp = y1;
+      y1 = y2;
+      y2 = temp;
+
+      temp = x1;
+      x1 = x2;
+      x2 = temp;
+   }
+
+   if (dy > dx) {
+      d = (2 * dx) - dy;     /* Slope > 1 */
+      i1 = 2 * dx;
+      i2 = 2 * (dx - dy);
+
+      if (y1 > y2) {
+         x = x2;
+         y = y2;
+         yend = y1;
+      }
+      else {
+         x = x1;
+         y = y1;
+         yend = y2;
+      }
+
+      if (x1 > x2)
+         xinc = -1;
+      else
+         xinc = 1;
+
+      if (inside || inClip(x, y))
+         rowAddr(y)[x] = p;
+
+      while (y < yend) {
+         y++;
+         if (d < 0)
+            d += i1;
+         else {
+            x += xinc;
+            d += i2;
+         }
+
+         if (inside || inClip(x, y))
+            rowAddr(y)[x] = p;
+      }
+   }
+   else {
+      d = (2 * dy) - dx;  /* Slope < 1 */
+      i1 = 2 * dy;
+      i2 = 2 * (dy - dx);
+
+      if (x1 > x2) {
+         x = x2;
+         y = y2;
+         xend = x1;
+      }
+      else {
+         x = x1;
+         y = y1;
+         xend = x2;
+      }
+
+      if (y1 > y2)
+         yinc = -1;
+      else
+         yinc = 1;
+
+      if (inside || inClip(x, y))
+         rowAddr(y)[x] = p;
+
+      while (x < xend) {
+         x++;
+         if (d < 0)
+            d += i1;
+         else {
+            y += yinc;
+            d += i2;
+         }
+
+         if (inside || inClip(x, y))
+            rowAddr(y)[x] = p;
+      }
+   }
+}
+
+// Called through pointers, so that neither is inlined into the timing loops
+void (*volatile OldLine)(int, int, int, int, const int) = oldLine;
+void (*volatile NewLine)(int, int, int, int, const int) = drawLine;
+
+
+/* sameLines --- return the number of end point pairs where the two lines differ */
+
+static int sameLines(void)
+{
+   int x1, y1, x2, y2;
+   int n = 0, bad = 0;
+
+   for (x1 = -20; x1 < (MAXX + 20); x1 += 9)
+      for (y1 = -20; y1 < (MAXY + 20); y1 += 11)
+         for (x2 = -20; x2 < (MAXX + 20); x2 += 7)
+            for (y2 = -20; y2 < (MAXY + 20); y2 += 5) {
+               if ((n % 5) == 0)
+                  setClip(n % 37, n % 23, (MAXX - 1) - (n % 41), (MAXY - 1) - (n % 19));
+               else if ((n % 5) == 1)
+                  resetClip();
+
+               memset(Frame, 0, sizeof (Frame));
+               oldLine(x1, y1, x2, y2, SSD1351_WHITE);
+               memcpy(Ref, Frame, sizeof (Frame));
+
+               memset(Frame, 0, sizeof (Frame));
+               drawLine(x1, y1, x2, y2, SSD1351_WHITE);
+
+               if (memcmp(Ref, Frame, sizeof (Frame)) != 0)
+                  bad++;
+
+               n++;
+            }
+
+   resetClip();
+
+   printf("%d lines compared\n", n);
+
+   return (bad);
+}
+
+
+/* timeLines --- time one line drawing function on each kind of line */
+
+static void timeLines(const char *name, void (*const line)(int, int, int, int, const int))
+{
+   int i, a, x;
+   double t;
+
+   // Radar vectors, as drawRadarVector() draws them
+   t = simSeconds();
+
+   for (i = 0; i < LINE_LOOPS; i++)
+      for (a = 0; a < 360; a += SCANNER_INC_DEGREES)
+         line(CENX, CENY, CENX + ((SCANNER_RADIUS * icos(a)) / SIN_SCALE), CENY + ((SCANNER_RADIUS * isin(a)) / SIN_SCALE), SSD1351_GREEN);
+
+   printf("%s: radar vector %.1f ns\n", name, ((simSeconds() - t) * 1e9) / (LINE_LOOPS * (360 / SCANNER_INC_DEGREES)));
+
+   // Shallow and steep lines from edge to edge
+   t = simSeconds();
+
+   for (i = 0; i < LINE_LOOPS; i++)
+      for (x = 0; x < MAXX; x += 8) {
+         line(0, x, MAXX - 1, (MAXY - 1) - x, SSD1351_RED);
+         line(x, 0, (MAXX - 1) - x, MAXY - 1, SSD1351_RED);
+      }
+
+   printf("%s: diagonal %.1f ns\n", name, ((simSeconds() - t) * 1e9) / (LINE_LOOPS * (MAXX / 8) * 2));
+
+   // Full-screen horizontal and vertical lines
+   t = simSeconds();
+
+   for (i = 0; i < LINE_LOOPS; i++)
+      for (x = 0; x < MAXX; x += 8) {
+         line(x, 0, x, MAXY - 1, SSD1351_BLUE);
+         line(0, x, MAXX - 1, x, SSD1351_BLUE);
+      }
+
+   printf("%s: axis-aligned %.1f ns\n", name, ((simSeconds() - t) * 1e9) / (LINE_LOOPS * (MAXX / 8) * 2));
+}
+
+
+int main(void)
+{
+   simBegin();
+
+   initSPI();
+   OLED_begin(MAXX, MAXY);
+
+#ifdef INDEXED_FRAME
+   initPalette();
+#endif
+
+   CHECK(sameLines() == 0);
+
+   timeLines("Old drawLine", OldLine);
+   timeLines("New drawLine", NewLine);
+
+   return (simReport("linebench"));
+}
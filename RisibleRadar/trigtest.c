@@ -0,0 +1,174 @@
+/* trigtest --- check the fixed-point trig functions against the C library */
+
+// Built for the host by 'make check', with the firmware included whole.
+// isin() and icos() must be within half a unit of the true value, as
+// the tables are rounded. isqrt() must round down exactly. iatan2() must
+// give a bearing from 0 up to 360 degrees that's within 0.02 degrees of
+// atan2(), over the playfield and beyond.
+
+#define main risible_main
+#include "RisibleRadar.c"
+#undef main
+
+#include <stdio.h>
+#include <math.h>
+
+#include "oledsim.h"
+
+#define MAX_SIN_ERROR    (0.500001)   // Units of 1/SIN_SCALE; sin(30) * SIN_SCALE is x.5
+#define MAX_ATAN_ERROR   (0.02)       // Degrees
+
+#define RADIANS  (atan(1.0) / 45.0)   // In one degree
+
+
+/* checkSines --- compare isin() and icos() with sin() and cos() */
+
+static double checkSines(void)
+{
+   int deg;
+   double e, worst = 0.0;
+
+   for (deg = -720; deg <= 720; deg++) {
+      e = fabs(isin(deg) - (SIN_SCALE * sin(deg * RADIANS)));
+
+      if (e > worst)
+         worst = e;
+
+      e = fabs(icos(deg) - (SIN_SCALE * cos(deg * RADIANS)));
+
+      if (e > worst)
+         worst = e;
+   }
+
+   return (worst);
+}
+
+
+/* rootOK --- return true if 'root' is the square root of 'n', rounded down */
+
+static bool rootOK(const unsigned int n, const unsigned int root)
+{
+   return ((((uint64_t)root * root) <= n) && ((((uint64_t)root + 1) * (root + 1)) > n));
+}
+
+
+/* checkRoots --- return the number of wrong answers from isqrt() */
+
+static int checkRoots(void)
+{
+   uint64_t n;
+   unsigned int r;
+   int bad = 0;
+
+   for (n = 0; n < 1000000; n++)
+      bad += !rootOK(n, isqrt(n));
+
+   // Sparsely up to the top of the range, and either side of every square
+   for (n = 1000000; n <= UINT32_MAX; n += 65521)
+      bad += !rootOK(n, isqrt(n));
+
+   for (r = 1; r < 65536; r++) {
+      n = (uint64_t)r * r;
+
+      bad += !rootOK(n - 1, isqrt(n - 1));
+      bad += !rootOK(n, isqrt(n));
+
+      if (n < UINT32_MAX)
+         bad += !rootOK(n + 1, isqrt(n + 1));
+   }
+
+   bad += !rootOK(UINT32_MAX, isqrt(UINT32_MAX));
+
+   return (bad);
+}
+
+
+/* bearingError --- return how far iatan2() is from atan2(), in degrees */
+
+static double bearingError(const int y, const int x, bool *const inRange)
+{
+   const int a = iatan2(y, x);
+   double b, e;
+
+   *inRange = (a >= 0) && (a < (360 * DEG_SCALE));
+
+   if ((x == 0) && (y == 0))
+      return (0.0);
+
+   b = atan2(y, x) / RADIANS;
+
+   if (b < 0.0)
+      b += 360.0;
+
+   e = fabs(((double)a / DEG_SCALE) - b);
+
+   if (e > 180.0)
+      e = 360.0 - e;
+
+   return (e);
+}
+
+
+/* checkBearings --- compare iatan2() with atan2() */
+
+static double checkBearings(int *const outOfRange)
+{
+   static const int big[] = {1000, 4095, 65535, 65536, 1 << 20, 1 << 24, INT32_MAX / 2, INT32_MAX};
+   int x, y, i, j;
+   double e, worst = 0.0;
+   bool inRange;
+
+   *outOfRange = 0;
+
+   for (y = -600; y <= 600; y++) {
+      for (x = -600; x <= 600; x++) {
+         e = bearingError(y, x, &inRange);
+
+         if (e > worst)
+            worst = e;
+
+         *outOfRange += !inRange;
+      }
+   }
+
+   // Long vectors, which have to be shifted down to fit the tangent in 32 bits
+   for (i = 0; i < (int)(sizeof (big) / sizeof (big[0])); i++) {
+      for (j = 0; j < 360; j++) {
+         x = lrint(big[i] * cos(j * RADIANS));
+         y = lrint(big[i] * sin(j * RADIANS));
+
+         e = bearingError(y, x, &inRange);
+
+         if (e > worst)
+            worst = e;
+
+         *outOfRange += !inRange;
+      }
+   }
+
+   return (worst);
+}
+
+
+int main(void)
+{
+   double worstSin, worstAtan;
+   int outOfRange;
+   int badRoots;
+
+   simBegin();
+
+   worstSin = checkSines();
+   badRoots = checkRoots();
+   worstAtan = checkBearings(&outOfRange);
+
+   printf("isin/icos: worst error %.3f units; isqrt: %d wrong; iatan2: worst error %.4f degrees\n",
+          worstSin, badRoots, worstAtan);
+
+   CHECK(worstSin <= MAX_SIN_ERROR);
+   CHECK(badRoots == 0);
+   CHECK(worstAtan <= MAX_ATAN_ERROR);
+   CHECK(outOfRange == 0);
+
+   return (simReport("trigtest"));
+}
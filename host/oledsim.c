@@ -0,0 +1,608 @@
+/* oledsim --- simulated SPI, DMA and SSD1351 OLED for host tests */
+
+// The firmware is compiled against a stand-in CMSIS header, which
+// sends every access to SPI1, GPIOA and the DMA controller through the
+// functions here. Building with STM32F103xB defined simulates the
+// BluePill's DMA1 Channel 3, and otherwise DMA2 Stream 3 of the F411. Each access first settles the one before it: a word
+// written to the SPI data register goes to the OLED model, a write to
+// BSRR moves the GPIO pins, and so on. DMA runs from a timer signal, a
+// few dozen words at a time, so that it overlaps the firmware as it
+// would on the chip, and its interrupt handler is called from the
+// signal handler much as the NVIC would call it.
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
+
+#ifdef STM32F103xB
+#include <stm32f1xx.h>
+#else
+#include <stm32f4xx.h>
+#endif
+
+#include "oledsim.h"
+
+#ifdef STM32F103xB
+#define SIM_CPU_HZ      (72000000)    // Clock of the STM32F103
+#else
+#define SIM_CPU_HZ      (100000000)   // Rate of the DWT cycle counter
+#endif
+#define SIM_TICK_US     (100)         // Time between DMA steps
+#define SIM_TICK_WORDS  (80)          // Words sent by DMA in each step, about right for 12.5MHz
+
+#define SIM_MAX_ERRORS  (10)          // Errors printed before we go quiet
+
+#define DR_EMPTY  (0xFFFFFFFF)        // Nothing written to SPI1->DR since it was last looked at
+
+#define CS_PIN  (1 << 4)              // PA4
+
+#ifdef STM32F103xB
+#define DC_PIN  (1 << 12)             // PA12
+
+// DMA1 Channel 3 is SPI1_TX. EN stays set when the transfer is done
+#define DMA_EN        DMA_CCR_EN
+#define DMA_TCIE      DMA_CCR_TCIE
+#define DMA_TOPERIPH  DMA_CCR_DIR
+#define DMA_MINC      DMA_CCR_MINC
+#define DMA_MSIZE     DMA_CCR_MSIZE_0
+#define DMA_TCIF      DMA_ISR_TCIF3
+#define DMA_IRQn      DMA1_Channel3_IRQn
+#define DMA_NAME      "DMA1 Channel 3"
+
+#define DmaHandler    DMA1_Channel3_IRQHandler
+#else
+#define DC_PIN  (1 << 3)              // PA3
+
+// DMA2 Stream 3 is SPI1_TX on channel 3. EN is cleared when the transfer is done
+#define DMA_EN        DMA_SxCR_EN
+#define DMA_TCIE      DMA_SxCR_TCIE
+#define DMA_TOPERIPH  DMA_SxCR_DIR_0
+#define DMA_MINC      DMA_SxCR_MINC
+#define DMA_MSIZE     DMA_SxCR_MSIZE_0
+#define DMA_TCIF      DMA_LISR_TCIF3
+#define DMA_IRQn      DMA2_Stream3_IRQn
+#define DMA_NAME      "DMA2 Stream 3"
+
+#define DmaHandler    DMA2_Stream3_IRQHandler
+#endif
+
+#define SSD1351_SETCOLUMN      (0x15)
+#define SSD1351_SETROW         (0x75)
+#define SSD1351_WRITERAM       (0x5C)
+#define SSD1351_STARTLINE      (0xA1)
+#define SSD1351_HORIZSCROLL    (0x96)
+#define SSD1351_STOPSCROLL     (0x9E)
+#define SSD1351_STARTSCROLL    (0x9F)
+
+void DmaHandler(void) __attribute__((weak));
+
+struct sim_oled Oled;
+
+uint16_t SimTrace[SIM_TRACE_SIZE];
+uint32_t SimTraceLen = 0;
+
+int SimErrors = 0;
+int SimFailures = 0;
+
+// Peripherals the firmware only sets up
+FLASH_TypeDef HostFLASH;
+GPIO_TypeDef HostGPIOB, HostGPIOC;
+RCC_TypeDef HostRCC;
+TIM_TypeDef HostTIM4;
+USART_TypeDef HostUSART1;
+#ifndef STM32F103xB
+ADC_TypeDef HostADC1;
+CoreDebug_Type HostCoreDebug;
+#endif
+
+uint32_t SystemCoreClock = SIM_CPU_HZ;
+
+// Peripherals we simulate
+static SPI_TypeDef Spi1;
+static GPIO_TypeDef GpioA;
+#ifdef STM32F103xB
+static DMA_TypeDef Dma1;
+static DMA_Channel_TypeDef Dma1Channel3;
+
+#define DmaCR     (Dma1Channel3.CCR)
+#define DmaCount  (Dma1Channel3.CNDTR)
+#define DmaPAR    (Dma1Channel3.CPAR)
+#define DmaMAR    (Dma1Channel3.CMAR)
+#define DmaFlags  (Dma1.ISR)
+#define DmaClear  (Dma1.IFCR)
+#else
+static DMA_TypeDef Dma2;
+static DMA_Stream_TypeDef Dma2Stream3;
+static DWT_Type Dwt;
+
+#define DmaCR     (Dma2Stream3.CR)
+#define DmaCount  (Dma2Stream3.NDTR)
+#define DmaPAR    (Dma2Stream3.PAR)
+#define DmaMAR    (Dma2Stream3.M0AR)
+#define DmaFlags  (Dma2.LISR)
+#define DmaClear  (Dma2.LIFCR)
+#endif
+
+// DMA transfer: not enabled, sending, or finished but still enabled
+static enum {DMA_IDLE, DMA_RUNNING, DMA_DONE} DmaState = DMA_IDLE;
+static uintptr_t DmaAddr;
+
+// State of the OLED's command parser
+static uint8_t Cmd;         // Last command byte
+static uint8_t Args[8];     // Its arguments so far
+static int NArgs;
+static int HiByte = -1;     // First byte of a pixel, or -1
+static uint8_t Col1, Col2, Row1, Row2;
+static uint8_t Col, Row;
+
+// Interrupts
+static uint32_t NvicEnabled[4];
+static volatile sig_atomic_t IrqPending = 0;
+static volatile sig_atomic_t IrqMasked = 0;
+static volatile sig_atomic_t InIsr = 0;
+static volatile sig_atomic_t InSim = 0;
+static volatile sig_atomic_t TickDue = 0;
+
+static struct timespec Start;
+
+#ifndef STM32F103xB
+static uint32_t DwtBase, DwtLast;
+#endif
+
+
+/* simError --- note something that would go wrong on real hardware */
+
+static void simError(const char *what)
+{
+   if (SimErrors++ < SIM_MAX_ERRORS)
+      fprintf(stderr, "oledsim: %s\n", what);
+}
+
+
+/* oledCommand --- act on a command once all its arguments have arrived */
+
+static void oledCommand(void)
+{
+   switch (Cmd) {
+   case SSD1351_SETCOLUMN:
+   case SSD1351_SETROW:
+      if (NArgs < 2)
+         return;
+
+      if ((Args[0] > 127) || (Args[1] > 127) || (Args[0] > Args[1]))
+         simError("Bad window");
+
+      if (Cmd == SSD1351_SETCOLUMN) {
+         Col1 = Args[0] & 127;
+         Col2 = Args[1] & 127;
+      }
+      else {
+         Row1 = Args[0] & 127;
+         Row2 = Args[1] & 127;
+      }
+      break;
+   case SSD1351_STARTLINE:
+      if (NArgs < 1)
+         return;
+
+      Oled.startLine = Args[0] & 127;
+      break;
+   case SSD1351_HORIZSCROLL:
+      if (NArgs < 5)
+         return;
+
+      memcpy(Oled.scroll, Args, sizeof (Oled.scroll));
+      break;
+   }
+}
+
+
+/* oledByte --- receive one byte on the OLED's SPI interface */
+
+static void oledByte(const uint8_t b)
+{
+   const bool dc = (GpioA.ODR & DC_PIN) != 0;
+
+   if (GpioA.ODR & CS_PIN) {
+      simError("Byte sent with CS high");
+      return;
+   }
+
+   Oled.bytes++;
+
+   if (SimTraceLen < SIM_TRACE_SIZE)
+      SimTrace[SimTraceLen++] = b | (dc ? SIM_DC : 0);
+
+   if (!dc) {
+      Cmd = b;
+      NArgs = 0;
+      HiByte = -1;
+
+      switch (Cmd) {
+      case SSD1351_WRITERAM:
+         Col = Col1;
+         Row = Row1;
+         Oled.windows++;
+         break;
+      case SSD1351_STARTSCROLL:
+         Oled.scrolling = true;
+         break;
+      case SSD1351_STOPSCROLL:
+         Oled.scrolling = false;
+         break;
+      }
+   }
+   else if (Cmd == SSD1351_WRITERAM) {
+      if (HiByte < 0) {
+         HiByte = b;
+         return;
+      }
+
+      // Rows outside the band go on being written as usual
+      if (Oled.scrolling && (Row >= Oled.scroll[1]) && (Row < (Oled.scroll[1] + Oled.scroll[2])))
+         simError("Scrolling band written while scrolling");
+
+      Oled.ram[Row][Col] = (HiByte << 8) | b;
+      Oled.pixels++;
+      HiByte = -1;
+
+      // The address wraps around the window, as on the SSD1351
+      if (Col < Col2)
+         Col++;
+      else {
+         Col = Col1;
+         Row = (Row < Row2) ? Row + 1 : Row1;
+      }
+   }
+   else if (NArgs < (int)sizeof (Args)) {
+      Args[NArgs++] = b;
+      oledCommand();
+   }
+}
+
+
+/* spiOut --- send a word through SPI1 to the OLED */
+
+static void spiOut(const uint32_t w)
+{
+   if ((Spi1.CR1 & SPI_CR1_SPE) == 0)
+      simError("SPI1 used while disabled");
+
+   if (Spi1.CR1 & SPI_CR1_DFF) {    // 16-bit frames go most significant byte first
+      oledByte(w >> 8);
+      oledByte(w);
+   }
+   else
+      oledByte(w);
+}
+
+
+/* settle --- finish off the last access to the simulated registers */
+
+static void settle(void)
+{
+   if (Spi1.DR != DR_EMPTY) {
+      spiOut(Spi1.DR);
+      Spi1.DR = DR_EMPTY;
+   }
+
+   Spi1.SR = SPI_SR_TXE | SPI_SR_RXNE;    // Never busy, and there's always a byte to read
+
+   if (GpioA.BSRR != 0) {
+      GpioA.ODR = (GpioA.ODR | (GpioA.BSRR & 0xFFFF)) & ~(GpioA.BSRR >> 16);
+      GpioA.BSRR = 0;
+   }
+
+   if (DmaClear != 0) {
+      DmaFlags &= ~DmaClear;
+      DmaClear = 0;
+   }
+
+   if ((DmaCR & DMA_EN) == 0)
+      DmaState = DMA_IDLE;
+}
+
+
+/* dmaStep --- let the SPI1_TX DMA channel send a few words to SPI1 */
+
+static void dmaStep(int words)
+{
+   if (((DmaCR & DMA_EN) == 0) || (DmaState == DMA_DONE))
+      return;
+
+   if (DmaState == DMA_IDLE) {    // Just enabled, so pick up the addresses
+      if (DmaPAR != (uint32_t)(uintptr_t)&Spi1.DR)
+         simError(DMA_NAME " isn't aimed at SPI1");
+
+      if ((DmaCR & DMA_TOPERIPH) == 0)
+         simError(DMA_NAME " isn't memory-to-peripheral");
+
+      DmaAddr = DmaMAR;
+      DmaState = DMA_RUNNING;
+   }
+
+   if ((Spi1.CR2 & SPI_CR2_TXDMAEN) == 0)
+      return;     // SPI1 isn't asking for anything
+
+   for ( ; (words > 0) && (DmaCount > 0); words--) {
+      const int size = (DmaCR & DMA_MSIZE) ? 2 : 1;
+
+      spiOut((size == 2) ? *(const uint16_t *)DmaAddr : *(const uint8_t *)DmaAddr);
+
+      if (DmaCR & DMA_MINC)
+         DmaAddr += size;
+
+      DmaCount--;
+   }
+
+   if (DmaCount == 0) {
+      DmaState = DMA_DONE;
+      DmaFlags |= DMA_TCIF;
+
+#ifndef STM32F103xB
+      DmaCR &= ~DMA_EN;
+#endif
+
+      if (DmaCR & DMA_TCIE)
+         IrqPending = 1;
+   }
+}
+
+
+/* deliver --- call the DMA interrupt handler if it's pending and allowed */
+
+static void deliver(void)
+{
+   const int n = DMA_IRQn;
+
+   while (IrqPending && !IrqMasked && !InIsr && (NvicEnabled[n / 32] & (1u << (n % 32))) && DmaHandler) {
+      IrqPending = 0;
+      InIsr = 1;
+      DmaHandler();
+      InIsr = 0;
+   }
+}
+
+
+/* tick --- move time on by one step of the simulation */
+
+static void tick(void)
+{
+   InSim = 1;
+   settle();
+   dmaStep(SIM_TICK_WORDS);
+   InSim = 0;
+
+   deliver();
+}
+
+
+/* onAlarm --- timer signal handler, standing in for the passage of time */
+
+static void onAlarm(int sig)
+{
+   (void)sig;
+
+   if (InSim)
+      TickDue = 1;     // Come back when the firmware has finished with the registers
+   else
+      tick();
+}
+
+
+/* access --- settle the registers before the firmware touches them again */
+
+static void access(void)
+{
+   InSim = 1;
+   settle();
+   InSim = 0;
+
+   if (TickDue) {
+      TickDue = 0;
+      tick();
+   }
+}
+
+
+SPI_TypeDef *hostSPI1(void)
+{
+   access();
+
+   return (&Spi1);
+}
+
+
+GPIO_TypeDef *hostGPIOA(void)
+{
+   access();
+
+   return (&GpioA);
+}
+
+
+#ifdef STM32F103xB
+DMA_TypeDef *hostDMA1(void)
+{
+   access();
+
+   return (&Dma1);
+}
+
+
+DMA_Channel_TypeDef *hostDMA1Channel3(void)
+{
+   access();
+
+   return (&Dma1Channel3);
+}
+#else
+DMA_TypeDef *hostDMA2(void)
+{
+   access();
+
+   return (&Dma2);
+}
+
+
+DMA_Stream_TypeDef *hostDMA2Stream3(void)
+{
+   access();
+
+   return (&Dma2Stream3);
+}
+
+
+/* hostDWT --- return the cycle counter, running at SIM_CPU_HZ in host time */
+
+DWT_Type *hostDWT(void)
+{
+   const uint32_t now = simSeconds() * SIM_CPU_HZ;
+
+   if (Dwt.CYCCNT != DwtLast)    // The firmware has set it
+      DwtBase = now - Dwt.CYCCNT;
+
+   Dwt.CYCCNT = DwtLast = now - DwtBase;
+
+   return (&Dwt);
+}
+#endif
+
+
+void NVIC_EnableIRQ(const IRQn_Type irq)
+{
+   NvicEnabled[irq / 32] |= 1u << (irq % 32);
+
+   deliver();
+}
+
+
+void NVIC_DisableIRQ(const IRQn_Type irq)
+{
+   NvicEnabled[irq / 32] &= ~(1u << (irq % 32));
+}
+
+
+uint32_t SysTick_Config(const uint32_t ticks)
+{
+   (void)ticks;
+
+   return (0);
+}
+
+
+void __enable_irq(void)
+{
+   IrqMasked = 0;
+
+   deliver();
+}
+
+
+void __disable_irq(void)
+{
+   IrqMasked = 1;
+}
+
+
+/* simBegin --- reset the simulation and start the clock */
+
+void simBegin(void)
+{
+   struct sigaction sa;
+   struct itimerval it;
+
+   clock_gettime(CLOCK_MONOTONIC, &Start);
+
+   memset(&Oled, 0, sizeof (Oled));
+
+   Spi1.DR = DR_EMPTY;
+   Spi1.SR = SPI_SR_TXE | SPI_SR_RXNE;
+   GpioA.ODR = CS_PIN | DC_PIN;
+
+   Col1 = Row1 = 0;
+   Col2 = Row2 = 127;
+
+   simTraceReset();
+
+   memset(&sa, 0, sizeof (sa));
+   sa.sa_handler = onAlarm;
+   sa.sa_flags = SA_RESTART;
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGALRM, &sa, NULL);
+
+   it.it_interval.tv_sec = 0;
+   it.it_interval.tv_usec = SIM_TICK_US;
+   it.it_value = it.it_interval;
+   setitimer(ITIMER_REAL, &it, NULL);
+}
+
+
+/* simSettle --- let the last byte written by the firmware reach the OLED */
+
+void simSettle(void)
+{
+   access();
+}
+
+
+/* simTraceReset --- start recording bytes sent to the OLED afresh */
+
+void simTraceReset(void)
+{
+   simSettle();    // Anything already written belongs to the old trace
+
+   SimTraceLen = 0;
+}
+
+
+/* simScreen --- return the pixel that the OLED shows at a screen position */
+
+uint16_t simScreen(const int x, const int y)
+{
+   return (Oled.ram[(y + Oled.startLine) & 127][x]);
+}
+
+
+/* simSeconds --- return the time since simBegin() */
+
+double simSeconds(void)
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+
+   return ((now.tv_sec - Start.tv_sec) + ((now.tv_nsec - Start.tv_nsec) / 1e9));
+}
+
+
+/* simFail --- report a check that failed */
+
+void simFail(const char *file, const int line, const char *what)
+{
+   fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+
+   SimFailures++;
+}
+
+
+/* simReport --- say how the test went and return its exit status */
+
+int simReport(const char *name)
+{
+   simSettle();
+
+   if ((SimFailures == 0) && (SimErrors == 0)) {
+      printf("%s: passed\n", name);
+      return (EXIT_SUCCESS);
+   }
+
+   printf("%s: FAILED, %d checks failed, %d hardware errors\n", name, SimFailures, SimErrors);
+
+   return (EXIT_FAILURE);
+}
@@ -0,0 +1,47 @@
+/* oledsim.h --- simulated SPI, DMA and SSD1351 OLED for host tests */
+
+#ifndef OLEDSIM_H
+#define OLEDSIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_TRACE_SIZE  (1 << 20)   // Bytes kept in SimTrace
+
+#define SIM_DC  (0x100)   // Set in a SimTrace entry for data, clear for a command
+
+// What the OLED controller has been sent
+struct sim_oled {
+   uint16_t ram[128][128];   // Display RAM, in the rows and columns used by SETROW and SETCOLUMN
+   uint8_t startLine;        // Display RAM row shown at the top of the screen
+   bool scrolling;           // Horizontal scrolling is running
+   uint8_t scroll[5];        // Arguments of the last HORIZSCROLL
+   uint32_t bytes;           // Bytes received, commands included
+   uint32_t windows;         // Number of WRITERAM commands
+   uint32_t pixels;          // Number of pixels written to RAM
+};
+
+extern struct sim_oled Oled;
+
+// Every byte received since simTraceReset(), with SIM_DC set for data
+extern uint16_t SimTrace[SIM_TRACE_SIZE];
+extern uint32_t SimTraceLen;
+
+// Things seen that would go wrong on real hardware
+extern int SimErrors;
+
+// Checks that have failed
+extern int SimFailures;
+
+// Count a failed check, saying where it was
+#define CHECK(cond)  ((cond) ? (void)0 : simFail(__FILE__, __LINE__, #cond))
+
+void simBegin(void);
+void simSettle(void);
+void simTraceReset(void);
+uint16_t simScreen(const int x, const int y);
+double simSeconds(void);
+void simFail(const char *file, const int line, const char *what);
+int simReport(const char *name);
+
+#endif
@@ -0,0 +1,245 @@
+/* stm32f1xx.h --- stand-in for the CMSIS STM32F1 header, for host tests */
+
+// Just enough of the real header to compile the firmware with the
+// native GCC. Register blocks are ordinary variables, and bit values are
+// those in CMSIS. SPI1, GPIOA and DMA1 go through functions in oledsim.c,
+// so that the simulation sees every access to them.
+
+#ifndef STM32F1XX_H
+#define STM32F1XX_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef int IRQn_Type;
+
+#define DMA1_Channel3_IRQn  (13)
+#define TIM4_IRQn           (30)
+#define USART1_IRQn         (37)
+
+typedef struct {
+   __IO uint32_t CCR;
+   __IO uint32_t CNDTR;
+   __IO uint32_t CPAR;
+   __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+   __IO uint32_t ISR;
+   __IO uint32_t IFCR;
+} DMA_TypeDef;
+
+typedef struct {
+   __IO uint32_t ACR;
+   __IO uint32_t KEYR;
+   __IO uint32_t OPTKEYR;
+   __IO uint32_t SR;
+   __IO uint32_t CR;
+   __IO uint32_t AR;
+   __IO uint32_t RESERVED;
+   __IO uint32_t OBR;
+   __IO uint32_t WRPR;
+} FLASH_TypeDef;
+
+typedef struct {
+   __IO uint32_t CRL;
+   __IO uint32_t CRH;
+   __IO uint32_t IDR;
+   __IO uint32_t ODR;
+   __IO uint32_t BSRR;
+   __IO uint32_t BRR;
+   __IO uint32_t LCKR;
+} GPIO_TypeDef;
+
+typedef struct {
+   __IO uint32_t CR;
+   __IO uint32_t CFGR;
+   __IO uint32_t CIR;
+   __IO uint32_t APB2RSTR;
+   __IO uint32_t APB1RSTR;
+   __IO uint32_t AHBENR;
+   __IO uint32_t APB2ENR;
+   __IO uint32_t APB1ENR;
+   __IO uint32_t BDCR;
+   __IO uint32_t CSR;
+} RCC_TypeDef;
+
+typedef struct {
+   __IO uint32_t CR1;
+   __IO uint32_t CR2;
+   __IO uint32_t SR;
+   __IO uint32_t DR;
+   __IO uint32_t CRCPR;
+   __IO uint32_t RXCRCR;
+   __IO uint32_t TXCRCR;
+   __IO uint32_t I2SCFGR;
+} SPI_TypeDef;
+
+typedef struct {
+   __IO uint32_t CR1;
+   __IO uint32_t CR2;
+   __IO uint32_t SMCR;
+   __IO uint32_t DIER;
+   __IO uint32_t SR;
+   __IO uint32_t EGR;
+   __IO uint32_t CCMR1;
+   __IO uint32_t CCMR2;
+   __IO uint32_t CCER;
+   __IO uint32_t CNT;
+   __IO uint32_t PSC;
+   __IO uint32_t ARR;
+} TIM_TypeDef;
+
+typedef struct {
+   __IO uint32_t SR;
+   __IO uint32_t DR;
+   __IO uint32_t BRR;
+   __IO uint32_t CR1;
+   __IO uint32_t CR2;
+   __IO uint32_t CR3;
+   __IO uint32_t GTPR;
+} USART_TypeDef;
+
+// Simulated peripherals, in oledsim.c
+SPI_TypeDef *hostSPI1(void);
+GPIO_TypeDef *hostGPIOA(void);
+DMA_TypeDef *hostDMA1(void);
+DMA_Channel_TypeDef *hostDMA1Channel3(void);
+
+// The rest just hold whatever the firmware writes
+extern FLASH_TypeDef HostFLASH;
+extern GPIO_TypeDef HostGPIOB, HostGPIOC;
+extern RCC_TypeDef HostRCC;
+extern TIM_TypeDef HostTIM4;
+extern USART_TypeDef HostUSART1;
+
+#define SPI1           (hostSPI1())
+#define GPIOA          (hostGPIOA())
+#define DMA1           (hostDMA1())
+#define DMA1_Channel3  (hostDMA1Channel3())
+#define FLASH          (&HostFLASH)
+#define GPIOB          (&HostGPIOB)
+#define GPIOC          (&HostGPIOC)
+#define RCC            (&HostRCC)
+#define TIM4           (&HostTIM4)
+#define USART1         (&HostUSART1)
+
+extern uint32_t SystemCoreClock;
+
+void NVIC_EnableIRQ(const IRQn_Type irq);
+void NVIC_DisableIRQ(const IRQn_Type irq);
+uint32_t SysTick_Config(const uint32_t ticks);
+void __enable_irq(void);
+void __disable_irq(void);
+
+// DMA
+#define DMA_CCR_EN                  (0x00000001)
+#define DMA_CCR_TCIE                (0x00000002)
+#define DMA_CCR_DIR                 (0x00000010)
+#define DMA_CCR_MINC                (0x00000080)
+#define DMA_CCR_PSIZE_0             (0x00000100)
+#define DMA_CCR_MSIZE_0             (0x00000400)
+#define DMA_ISR_TCIF3               (0x00000200)
+#define DMA_IFCR_CTCIF3             (0x00000200)
+
+// Flash
+#define FLASH_ACR_LATENCY_2         (0x00000004)
+
+// GPIO
+#define GPIO_CRL_MODE4              (0x00030000)
+#define GPIO_CRL_MODE4_0            (0x00010000)
+#define GPIO_CRL_MODE4_1            (0x00020000)
+#define GPIO_CRL_CNF4               (0x000C0000)
+#define GPIO_CRL_MODE5              (0x00300000)
+#define GPIO_CRL_MODE5_0            (0x00100000)
+#define GPIO_CRL_MODE5_1            (0x00200000)
+#define GPIO_CRL_CNF5               (0x00C00000)
+#define GPIO_CRL_CNF5_1             (0x00800000)
+#define GPIO_CRL_MODE6              (0x03000000)
+#define GPIO_CRL_CNF6               (0x0C000000)
+#define GPIO_CRL_CNF6_0             (0x04000000)
+#define GPIO_CRL_MODE7              (0x30000000)
+#define GPIO_CRL_MODE7_0            (0x10000000)
+#define GPIO_CRL_MODE7_1            (0x20000000)
+#define GPIO_CRL_CNF7               (0xC0000000)
+#define GPIO_CRL_CNF7_1             (0x80000000)
+#define GPIO_CRH_MODE9              (0x00000030)
+#define GPIO_CRH_MODE9_0            (0x00000010)
+#define GPIO_CRH_MODE9_1            (0x00000020)
+#define GPIO_CRH_CNF9               (0x000000C0)
+#define GPIO_CRH_CNF9_1             (0x00000080)
+#define GPIO_CRH_MODE10             (0x00000300)
+#define GPIO_CRH_CNF10              (0x00000C00)
+#define GPIO_CRH_CNF10_1            (0x00000800)
+#define GPIO_CRH_MODE12             (0x00030000)
+#define GPIO_CRH_MODE12_0           (0x00010000)
+#define GPIO_CRH_MODE12_1           (0x00020000)
+#define GPIO_CRH_CNF12              (0x000C0000)
+#define GPIO_CRH_MODE13             (0x00300000)
+#define GPIO_CRH_MODE13_0           (0x00100000)
+#define GPIO_CRH_MODE13_1           (0x00200000)
+#define GPIO_CRH_CNF13              (0x00C00000)
+#define GPIO_CRH_MODE14             (0x03000000)
+#define GPIO_CRH_MODE14_0           (0x01000000)
+#define GPIO_CRH_MODE14_1           (0x02000000)
+#define GPIO_CRH_CNF14              (0x0C000000)
+#define GPIO_BSRR_BS4               (0x00000010)
+#define GPIO_BSRR_BS12              (0x00001000)
+#define GPIO_BSRR_BS13              (0x00002000)
+#define GPIO_BSRR_BS14              (0x00004000)
+#define GPIO_BSRR_BR4               (0x00100000)
+#define GPIO_BSRR_BR12              (0x10000000)
+#define GPIO_BSRR_BR13              (0x20000000)
+#define GPIO_BSRR_BR14              (0x40000000)
+
+// RCC
+#define RCC_CR_HSEON                (0x00010000)
+#define RCC_CR_HSERDY               (0x00020000)
+#define RCC_CR_PLLON                (0x01000000)
+#define RCC_CR_PLLRDY               (0x02000000)
+#define RCC_CFGR_SW_PLL             (0x00000002)
+#define RCC_CFGR_SWS                (0x0000000C)
+#define RCC_CFGR_SWS_PLL            (0x00000008)
+#define RCC_CFGR_PPRE1_DIV2         (0x00000400)
+#define RCC_CFGR_PLLSRC             (0x00010000)
+#define RCC_CFGR_PLLMULL9           (0x001C0000)
+#define RCC_AHBENR_DMA1EN           (0x00000001)
+#define RCC_APB1ENR_TIM4EN          (0x00000004)
+#define RCC_APB2ENR_IOPAEN          (0x00000004)
+#define RCC_APB2ENR_IOPBEN          (0x00000008)
+#define RCC_APB2ENR_IOPCEN          (0x00000010)
+#define RCC_APB2ENR_SPI1EN          (0x00001000)
+#define RCC_APB2ENR_USART1EN        (0x00004000)
+#define RCC_CSR_RMVF                (0x01000000)
+
+// SPI
+#define SPI_CR1_CPHA                (0x00000001)
+#define SPI_CR1_CPOL                (0x00000002)
+#define SPI_CR1_MSTR                (0x00000004)
+#define SPI_CR1_BR_0                (0x00000008)
+#define SPI_CR1_BR_1                (0x00000010)
+#define SPI_CR1_SPE                 (0x00000040)
+#define SPI_CR1_SSI                 (0x00000100)
+#define SPI_CR1_SSM                 (0x00000200)
+#define SPI_CR1_DFF                 (0x00000800)
+#define SPI_CR2_TXDMAEN             (0x00000002)
+#define SPI_SR_RXNE                 (0x00000001)
+#define SPI_SR_TXE                  (0x00000002)
+#define SPI_SR_BSY                  (0x00000080)
+
+// Timers
+#define TIM_CR1_CEN                 (0x00000001)
+#define TIM_DIER_UIE                (0x00000001)
+#define TIM_SR_UIF                  (0x00000001)
+
+// USART
+#define USART_SR_RXNE               (0x00000020)
+#define USART_SR_TXE                (0x00000080)
+#define USART_CR1_RE                (0x00000004)
+#define USART_CR1_TE                (0x00000008)
+#define USART_CR1_RXNEIE            (0x00000020)
+#define USART_CR1_TXEIE             (0x00000080)
+#define USART_CR1_UE                (0x00002000)
+
+#endif
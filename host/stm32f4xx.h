@@ -0,0 +1,339 @@
+/* stm32f4xx.h --- stand-in for the CMSIS STM32F4 header, for host tests */
+
+// Just enough of the real header to compile the firmware with the
+// native GCC. Register blocks are ordinary variables, and bit values are
+// those in CMSIS. SPI1, GPIOA, DMA2 and DWT go through functions in
+// oledsim.c, so that the simulation sees every access to them.
+
+#ifndef STM32F4XX_H
+#define STM32F4XX_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef int IRQn_Type;
+
+#define TIM4_IRQn          (30)
+#define USART1_IRQn        (37)
+#define DMA2_Stream3_IRQn  (59)
+
+typedef struct {
+   __IO uint32_t SR;
+   __IO uint32_t CR1;
+   __IO uint32_t CR2;
+   __IO uint32_t SMPR1;
+   __IO uint32_t SMPR2;
+   __IO uint32_t JOFR1;
+   __IO uint32_t JOFR2;
+   __IO uint32_t JOFR3;
+   __IO uint32_t JOFR4;
+   __IO uint32_t HTR;
+   __IO uint32_t LTR;
+   __IO uint32_t SQR1;
+   __IO uint32_t SQR2;
+   __IO uint32_t SQR3;
+   __IO uint32_t JSQR;
+   __IO uint32_t JDR1;
+   __IO uint32_t JDR2;
+   __IO uint32_t JDR3;
+   __IO uint32_t JDR4;
+   __IO uint32_t DR;
+} ADC_TypeDef;
+
+typedef struct {
+   __IO uint32_t CR;
+   __IO uint32_t NDTR;
+   __IO uint32_t PAR;
+   __IO uint32_t M0AR;
+   __IO uint32_t M1AR;
+   __IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+   __IO uint32_t LISR;
+   __IO uint32_t HISR;
+   __IO uint32_t LIFCR;
+   __IO uint32_t HIFCR;
+} DMA_TypeDef;
+
+typedef struct {
+   __IO uint32_t ACR;
+   __IO uint32_t KEYR;
+   __IO uint32_t OPTKEYR;
+   __IO uint32_t SR;
+   __IO uint32_t CR;
+   __IO uint32_t OPTCR;
+} FLASH_TypeDef;
+
+typedef struct {
+   __IO uint32_t MODER;
+   __IO uint32_t OTYPER;
+   __IO uint32_t OSPEEDR;
+   __IO uint32_t PUPDR;
+   __IO uint32_t IDR;
+   __IO uint32_t ODR;
+   __IO uint32_t BSRR;
+   __IO uint32_t LCKR;
+   __IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+   __IO uint32_t CR;
+   __IO uint32_t PLLCFGR;
+   __IO uint32_t CFGR;
+   __IO uint32_t CIR;
+   __IO uint32_t AHB1RSTR;
+   __IO uint32_t AHB2RSTR;
+   __IO uint32_t APB1RSTR;
+   __IO uint32_t APB2RSTR;
+   __IO uint32_t AHB1ENR;
+   __IO uint32_t AHB2ENR;
+   __IO uint32_t APB1ENR;
+   __IO uint32_t APB2ENR;
+   __IO uint32_t CSR;
+} RCC_TypeDef;
+
+typedef struct {
+   __IO uint32_t CR1;
+   __IO uint32_t CR2;
+   __IO uint32_t SR;
+   __IO uint32_t DR;
+   __IO uint32_t CRCPR;
+   __IO uint32_t RXCRCR;
+   __IO uint32_t TXCRCR;
+   __IO uint32_t I2SCFGR;
+   __IO uint32_t I2SPR;
+} SPI_TypeDef;
+
+typedef struct {
+   __IO uint32_t CR1;
+   __IO uint32_t CR2;
+   __IO uint32_t SMCR;
+   __IO uint32_t DIER;
+   __IO uint32_t SR;
+   __IO uint32_t EGR;
+   __IO uint32_t CCMR1;
+   __IO uint32_t CCMR2;
+   __IO uint32_t CCER;
+   __IO uint32_t CNT;
+   __IO uint32_t PSC;
+   __IO uint32_t ARR;
+} TIM_TypeDef;
+
+typedef struct {
+   __IO uint32_t SR;
+   __IO uint32_t DR;
+   __IO uint32_t BRR;
+   __IO uint32_t CR1;
+   __IO uint32_t CR2;
+   __IO uint32_t CR3;
+   __IO uint32_t GTPR;
+} USART_TypeDef;
+
+typedef struct {
+   __IO uint32_t CTRL;
+   __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+   __IO uint32_t DHCSR;
+   __IO uint32_t DCRSR;
+   __IO uint32_t DCRDR;
+   __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+// Simulated peripherals, in oledsim.c
+SPI_TypeDef *hostSPI1(void);
+GPIO_TypeDef *hostGPIOA(void);
+DMA_TypeDef *hostDMA2(void);
+DMA_Stream_TypeDef *hostDMA2Stream3(void);
+DWT_Type *hostDWT(void);
+
+// The rest just hold whatever the firmware writes
+extern ADC_TypeDef HostADC1;
+extern FLASH_TypeDef HostFLASH;
+extern GPIO_TypeDef HostGPIOB, HostGPIOC;
+extern RCC_TypeDef HostRCC;
+extern TIM_TypeDef HostTIM4;
+extern USART_TypeDef HostUSART1;
+extern CoreDebug_Type HostCoreDebug;
+
+#define SPI1          (hostSPI1())
+#define GPIOA         (hostGPIOA())
+#define DMA2          (hostDMA2())
+#define DMA2_Stream3  (hostDMA2Stream3())
+#define DWT           (hostDWT())
+#define ADC1          (&HostADC1)
+#define FLASH         (&HostFLASH)
+#define GPIOB         (&HostGPIOB)
+#define GPIOC         (&HostGPIOC)
+#define RCC           (&HostRCC)
+#define TIM4          (&HostTIM4)
+#define USART1        (&HostUSART1)
+#define CoreDebug     (&HostCoreDebug)
+
+extern uint32_t SystemCoreClock;
+
+void NVIC_EnableIRQ(const IRQn_Type irq);
+void NVIC_DisableIRQ(const IRQn_Type irq);
+uint32_t SysTick_Config(const uint32_t ticks);
+void __enable_irq(void);
+void __disable_irq(void);
+
+// ADC
+#define ADC_SR_EOC                  (0x00000002)
+#define ADC_CR2_ADON                (0x00000001)
+#define ADC_CR2_SWSTART             (0x40000000)
+#define ADC_SMPR2_SMP1_Pos          (3)
+#define ADC_SMPR2_SMP8_Pos          (24)
+
+// DMA
+#define DMA_SxCR_EN                 (0x00000001)
+#define DMA_SxCR_TCIE               (0x00000010)
+#define DMA_SxCR_DIR_0              (0x00000040)
+#define DMA_SxCR_MINC               (0x00000400)
+#define DMA_SxCR_PSIZE_0            (0x00000800)
+#define DMA_SxCR_MSIZE_0            (0x00002000)
+#define DMA_SxCR_CHSEL_Pos          (25)
+#define DMA_LISR_TCIF3              (0x08000000)
+#define DMA_LIFCR_CFEIF3            (0x00400000)
+#define DMA_LIFCR_CDMEIF3           (0x01000000)
+#define DMA_LIFCR_CTEIF3            (0x02000000)
+#define DMA_LIFCR_CHTIF3            (0x04000000)
+#define DMA_LIFCR_CTCIF3            (0x08000000)
+
+// Flash
+#define FLASH_ACR_LATENCY_2WS       (0x00000002)
+#define FLASH_ACR_PRFTEN            (0x00000100)
+#define FLASH_ACR_ICEN              (0x00000200)
+#define FLASH_ACR_DCEN              (0x00000400)
+
+// GPIO
+#define GPIO_MODER_MODER0_0         (0x00000001)
+#define GPIO_MODER_MODER0_1         (0x00000002)
+#define GPIO_MODER_MODER1_0         (0x00000004)
+#define GPIO_MODER_MODER1_1         (0x00000008)
+#define GPIO_MODER_MODER3_0         (0x00000040)
+#define GPIO_MODER_MODER4_0         (0x00000100)
+#define GPIO_MODER_MODER5_1         (0x00000800)
+#define GPIO_MODER_MODER6_1         (0x00002000)
+#define GPIO_MODER_MODER7_1         (0x00008000)
+#define GPIO_MODER_MODER8_1         (0x00020000)
+#define GPIO_MODER_MODER9_1         (0x00080000)
+#define GPIO_MODER_MODER10_1        (0x00200000)
+#define GPIO_MODER_MODER12_0        (0x01000000)
+#define GPIO_MODER_MODER13_0        (0x04000000)
+#define GPIO_MODER_MODER14_0        (0x10000000)
+#define GPIO_OSPEEDER_OSPEEDR8_0    (0x00010000)
+#define GPIO_OSPEEDER_OSPEEDR8_1    (0x00020000)
+#define GPIO_PUPDR_PUPD0_0          (0x00000001)
+#define GPIO_BSRR_BS3               (0x00000008)
+#define GPIO_BSRR_BS4               (0x00000010)
+#define GPIO_BSRR_BS13              (0x00002000)
+#define GPIO_BSRR_BS14              (0x00004000)
+#define GPIO_BSRR_BR3               (0x00080000)
+#define GPIO_BSRR_BR4               (0x00100000)
+#define GPIO_BSRR_BR13              (0x20000000)
+#define GPIO_BSRR_BR14              (0x40000000)
+
+// RCC
+#define RCC_CR_HSEON                (0x00010000)
+#define RCC_CR_HSERDY               (0x00020000)
+#define RCC_CR_PLLON                (0x01000000)
+#define RCC_CR_PLLRDY               (0x02000000)
+#define RCC_PLLCFGR_PLLM_Pos        (0)
+#define RCC_PLLCFGR_PLLM            (0x0000003F)
+#define RCC_PLLCFGR_PLLN_Pos        (6)
+#define RCC_PLLCFGR_PLLN            (0x00007FC0)
+#define RCC_PLLCFGR_PLLP            (0x00030000)
+#define RCC_PLLCFGR_PLLSRC_HSE      (0x00400000)
+#define RCC_PLLCFGR_PLLQ            (0x0F000000)
+#define RCC_PLLCFGR_PLLQ_0          (0x01000000)
+#define RCC_PLLCFGR_PLLQ_1          (0x02000000)
+#define RCC_PLLCFGR_PLLQ_2          (0x04000000)
+#define RCC_CFGR_SW                 (0x00000003)
+#define RCC_CFGR_SW_PLL             (0x00000002)
+#define RCC_CFGR_SWS                (0x0000000C)
+#define RCC_CFGR_SWS_PLL            (0x00000008)
+#define RCC_CFGR_PPRE1_DIV2         (0x00001000)
+#define RCC_CFGR_PPRE2_DIV2         (0x00008000)
+#define RCC_CFGR_MCO1_0             (0x00200000)
+#define RCC_CFGR_MCO1_1             (0x00400000)
+#define RCC_CFGR_MCO1PRE_0          (0x01000000)
+#define RCC_CFGR_MCO1PRE_1          (0x02000000)
+#define RCC_CFGR_MCO1PRE_2          (0x04000000)
+#define RCC_AHB1ENR_GPIOAEN         (0x00000001)
+#define RCC_AHB1ENR_GPIOBEN         (0x00000002)
+#define RCC_AHB1ENR_GPIOCEN         (0x00000004)
+#define RCC_AHB1ENR_DMA2EN          (0x00400000)
+#define RCC_APB1ENR_TIM4EN          (0x00000004)
+#define RCC_APB2ENR_USART1EN        (0x00000010)
+#define RCC_APB2ENR_ADC1EN          (0x00000100)
+#define RCC_APB2ENR_SPI1EN          (0x00001000)
+#define RCC_CSR_RMVF                (0x01000000)
+
+// SPI
+#define SPI_CR1_CPHA                (0x00000001)
+#define SPI_CR1_CPOL                (0x00000002)
+#define SPI_CR1_MSTR                (0x00000004)
+#define SPI_CR1_BR_0                (0x00000008)
+#define SPI_CR1_BR_1                (0x00000010)
+#define SPI_CR1_SPE                 (0x00000040)
+#define SPI_CR1_SSI                 (0x00000100)
+#define SPI_CR1_SSM                 (0x00000200)
+#define SPI_CR1_DFF                 (0x00000800)
+#define SPI_CR2_TXDMAEN             (0x00000002)
+#define SPI_SR_RXNE                 (0x00000001)
+#define SPI_SR_TXE                  (0x00000002)
+#define SPI_SR_BSY                  (0x00000080)
+
+// Timers
+#define TIM_CR1_CEN                 (0x00000001)
+#define TIM_DIER_UIE                (0x00000001)
+#define TIM_SR_UIF                  (0x00000001)
+
+// USART
+#define USART_SR_RXNE               (0x00000020)
+#define USART_SR_TXE                (0x00000080)
+#define USART_CR1_RE                (0x00000004)
+#define USART_CR1_TE                (0x00000008)
+#define USART_CR1_RXNEIE            (0x00000020)
+#define USART_CR1_TXEIE             (0x00000080)
+#define USART_CR1_UE                (0x00002000)
+
+// Core debug and the cycle counter
+#define CoreDebug_DEMCR_TRCENA_Msk  (0x01000000)
+#define DWT_CTRL_CYCCNTENA_Msk      (0x00000001)
+
+#ifdef __ARM_FEATURE_DSP
+// The Cortex-M4 SIMD intrinsics from cmsis_gcc.h, in plain C, so that
+// a host build with -D__ARM_FEATURE_DSP runs the firmware's DSP path
+static inline uint32_t __UQADD16(const uint32_t a, const uint32_t b)
+{
+   uint32_t lo = (a & 0xffff) + (b & 0xffff);
+   uint32_t hi = (a >> 16) + (b >> 16);
+
+   if (lo > 0xffff)
+      lo = 0xffff;
+
+   if (hi > 0xffff)
+      hi = 0xffff;
+
+   return (lo | (hi << 16));
+}
+
+static inline uint32_t __SMULBB(const uint32_t a, const uint32_t b)
+{
+   return ((int32_t)(int16_t)a * (int16_t)b);
+}
+
+static inline uint32_t __SMULTT(const uint32_t a, const uint32_t b)
+{
+   return ((int32_t)(int16_t)(a >> 16) * (int16_t)(b >> 16));
+}
+
+#define __PKHBT(a, b, sh)  ((((uint32_t)(a)) & 0x0000ffff) | ((((uint32_t)(b)) << (sh)) & 0xffff0000))
+#endif
+
+#endif
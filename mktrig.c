@@ -0,0 +1,76 @@
+/* mktrig --- generate fixed-point trig tables as a C header */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SIN_SCALE  (32767)    // Sines are scaled to fit a signed 16-bit number
+#define DEG_SCALE  (64)       // Arctangents are in 1/64ths of a degree
+#define ATAN_BITS  (7)        // Arctangent table has 2^7 steps between 0 and 45 degrees
+
+#define VALUES_PER_LINE  (10)  // Number of table entries per line of source code
+
+
+void writeTable(const char name[], const char comment[], const int n, double (*const fn)(const int));
+double sinQ15(const int deg);
+double atanDeg(const int i);
+
+int main(void)
+{
+   puts("/* trig.h --- fixed-point trig tables, generated by mktrig */");
+   puts("/* Do not edit: change mktrig.c and rebuild instead */");
+   puts("");
+   printf("#define SIN_SCALE  (%d)   // Full scale of a sine or cosine\n", SIN_SCALE);
+   printf("#define DEG_SCALE  (%d)      // Number of arctangent units in one degree\n", DEG_SCALE);
+   printf("#define ATAN_BITS  (%d)       // Fractional bits of the tangent used to index AtanTab\n", ATAN_BITS);
+   puts("");
+
+   writeTable("SinQ15", "Sine of 0 to 90 degrees, scaled by SIN_SCALE", 91, sinQ15);
+   puts("");
+   writeTable("AtanTab", "Arctangent of 0 to 1 in steps of 1/2^ATAN_BITS, in units of 1/DEG_SCALE degrees", (1 << ATAN_BITS) + 1, atanDeg);
+
+   return (0);
+}
+
+
+/* writeTable --- write one table of 16-bit numbers as a C array */
+
+void writeTable(const char name[], const char comment[], const int n, double (*const fn)(const int))
+{
+   int i;
+
+   printf("// %s\n", comment);
+   printf("const int16_t %s[%d] = {\n", name, n);
+
+   for (i = 0; i < n; i++) {
+      if ((i % VALUES_PER_LINE) == 0)
+         printf("   ");
+
+      printf("%5ld", lround(fn(i)));
+
+      if (i == (n - 1))
+         printf("\n");
+      else if ((i % VALUES_PER_LINE) == (VALUES_PER_LINE - 1))
+         printf(",\n");
+      else
+         printf(", ");
+   }
+
+   puts("};");
+}
+
+
+/* sinQ15 --- return the sine of an angle in degrees, scaled to 16 bits */
+
+double sinQ15(const int deg)
+{
+   return (sin(deg * M_PI / 180.0) * SIN_SCALE);
+}
+
+
+/* atanDeg --- return the arctangent of one table step, in fractions of a degree */
+
+double atanDeg(const int i)
+{
+   return (atan((double)i / (1 << ATAN_BITS)) * (180.0 / M_PI) * DEG_SCALE);
+}